@@ -0,0 +1,67 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../include/cpu.h"
+
+/* ALU benchmark
+ *
+ * Runs a loop made of ADD/ADC/SUB/SBC/CP in their register, (HL) and d8
+ * forms for a fixed number of frames and reports the emulated clock rate.
+ * Build it with different options to compare them, e.g.
+ *
+ *   make rebuild bench BUILD_TYPE=release
+ *   make rebuild bench BUILD_TYPE=release LAZY_FLAGS=1
+ */
+
+#define BENCH_FRAMES 6000
+#define NS_PER_S 1000000000.0
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / NS_PER_S;
+}
+
+int main(void) {
+    CPU cpu = new_cpu();
+
+    uint8_t program[] = {
+        0x21, 0x00, 0xC0,  // LD HL, 0xC000
+        0x80,              // ADD A, B
+        0x89,              // ADC A, C
+        0x92,              // SUB D
+        0x9B,              // SBC A, E
+        0xBC,              // CP H
+        0x86,              // ADD A, (HL)
+        0x8E,              // ADC A, (HL)
+        0x96,              // SUB (HL)
+        0x9E,              // SBC A, (HL)
+        0xBE,              // CP (HL)
+        0xC6, 0x35,        // ADD A, 0x35
+        0xCE, 0x17,        // ADC A, 0x17
+        0xD6, 0x29,        // SUB 0x29
+        0xDE, 0x0B,        // SBC A, 0x0B
+        0xFE, 0x80,        // CP 0x80
+        0x04,              // INC B
+        0x2C,              // INC L
+        0xC3, 0x03, 0x00,  // JP 0x0003
+    };
+    load_program(&cpu, program, sizeof(program));
+    for (uint16_t i = 0; i < 0x100; i++) {
+        mem_write(&cpu, 0xC000 + i, (uint8_t)(i * 7));  // NOLINT
+    }
+
+    double start = now();
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        run_frame(&cpu);
+    }
+    double elapsed = now() - start;
+
+    printf("%d frames (%llu T-cycles) in %.3f s, %.1f MHz\n", BENCH_FRAMES,
+           (unsigned long long)cpu.cycles, elapsed, (double)cpu.cycles / elapsed / 1e6);  // NOLINT
+    printf("A = 0x%02X, F = 0x%02X\n", cpu.registers.a, get_reg(&cpu, F));
+
+    free_cpu(&cpu);
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* Ahead-of-time compiled ROM images
+ *
+ * kogaboy-aot (tools/kogaboy_aot.c) follows the control flow of a ROM from
+ * its entry point, the RST vectors and the interrupt vectors and writes every
+ * block it finds as a C function made of the per-opcode handlers of
+ * handlers.h. Compiled into a shared object with the same build options as
+ * the emulator, the image is loaded with load_aot() and run_cycles() runs
+ * its blocks instead of interpreting them.
+ *
+ * Addresses without a compiled block, blocks in front of the breakpoint or
+ * past the deadline and blocks on ROM pages that were written to or switched
+ * to another bank since the image was loaded are all left to the interpreter.
+ *
+ * This header needs CPU, so include it after cpu.h or handlers.h.
+ */
+
+#define AOT_ABI_VERSION 1
+#define AOT_PAGE_COUNT (AOT_ROM_SIZE / PAGE_SIZE)
+#define AOT_MODULE_SYMBOL "kogaboy_aot_module"
+
+/* Build options that change how the generated code behaves,
+ * sizeof(CPU) covers the ones that only change the layout.
+ */
+#ifdef LAZY_FLAGS
+#define AOT_BUILD_FLAGS 1
+#else
+#define AOT_BUILD_FLAGS 0
+#endif
+
+typedef void (*AotBlockFn)(CPU *cpu);
+
+typedef struct {
+    AotBlockFn run;  /*NULL if no block starts at this address*/
+    uint16_t end;    /*Address following the last instruction*/
+    uint16_t cycles; /*Base cycles of all instructions*/
+} AotBlock;
+
+/* What the shared object exports as AOT_MODULE_SYMBOL */
+typedef struct {
+    uint32_t abi_version;
+    uint32_t cpu_size;
+    uint32_t build_flags;
+    uint32_t rom_checksum;
+    const AotBlock *blocks; /*Indexed by address, AOT_ROM_SIZE entries*/
+} AotModule;
+
+typedef struct AotRuntime {
+    void *handle; /*dlopen() handle, NULL for modules linked in directly*/
+    const AotModule *module;
+    const uint8_t *rom;         /*ROM the image was compiled from*/
+    bool dirty[AOT_PAGE_COUNT]; /*Set for ROM pages written since loading*/
+} AotRuntime;
+
+/* FNV-1a over the ROM, ties an image to the ROM it was compiled from */
+static inline uint32_t aot_checksum(const uint8_t *rom) {
+    uint32_t hash = 2166136261u;  // NOLINT
+    for (uint32_t addr = 0; addr < AOT_ROM_SIZE; addr++) {
+        hash = (hash ^ rom[addr]) * 16777619u;  // NOLINT
+    }
+    return hash;
+}
+
+#ifdef AOT
+bool load_aot(CPU *cpu, const char *path);
+bool attach_aot(CPU *cpu, const AotModule *module, void *handle);
+
+/* aot_block returns the compiled block starting at pc,
+ * or NULL if the interpreter has to run it.
+ */
+static inline const AotBlock *aot_block(const CPU *cpu, uint16_t pc) {
+    const AotRuntime *aot = cpu->aot;
+    if (aot == NULL || pc >= AOT_ROM_SIZE) {
+        return NULL;
+    }
+
+    const AotBlock *block = &aot->module->blocks[pc];
+    if (block->run == NULL) {
+        return NULL;
+    }
+    for (uint16_t page = pc >> BYTE_SIZE; page <= (block->end - 1) >> BYTE_SIZE; page++) {
+        // Pages an MBC switched to another bank don't hold the compiled code either
+        if (aot->dirty[page] || cpu->memory->bus.read_pages[page] != aot->rom + page * PAGE_SIZE) {
+            return NULL;
+        }
+    }
+
+    // Leave the breakpoint to the interpreter so run_cycles() can stop there
+    if (cpu->breakpoint > pc && cpu->breakpoint < block->end) {
+        return NULL;
+    }
+    return block;
+}
+#endif
@@ -0,0 +1,74 @@
+/* Decoded basic block cache
+ *
+ * A block is a run of instructions starting at some address and ending
+ * with the first jump, call or return (or after BLOCK_MAX_INSTS).
+ * Every instruction is stored already resolved to its handler together
+ * with its length and cycles, so running a cached block skips fetching
+ * and dispatching on the opcode bytes.
+ *
+ * Common idioms such as copy and polling loops are fused into a single
+ * superinstruction. It covers several opcodes, but only accounts for the
+ * cycles of the first one up front and adds the others as it runs them.
+ *
+ * Blocks are keyed by bank and start address and never cross into the
+ * next BANK_WINDOW_SIZE window, as that may map a different bank. Writing
+ * to a page that blocks were decoded from drops every block on it (see
+ * mem_write).
+ *
+ * With DYNAREC, blocks that ran often enough get compiled to native
+ * code by dynarec.c.
+ *
+ * This header needs OpHandler, so include it after handlers.h.
+ */
+
+#define BLOCK_MAX_INSTS 32
+#define BLOCK_CACHE_SIZE 1024 /*Must be a power of 2*/
+#define BANK_WINDOW_SIZE 0x2000 /*Smallest region an MBC switches*/
+
+typedef struct {
+    OpHandler handler;
+    uint8_t length;
+    uint8_t cycles;   /*Base cycles, taken jumps add theirs while running*/
+    uint8_t op_count; /*Number of opcodes, more than 1 for a superinstruction*/
+} BlockInst;
+
+typedef void (*NativeBlock)(CPU *cpu);
+
+typedef struct {
+    bool valid;
+    uint8_t inst_count;
+    uint16_t bank;
+    uint16_t start;  /*Address of the first instruction*/
+    uint16_t end;    /*Address following the last instruction*/
+    uint32_t cycles; /*Base cycles of all instructions*/
+    BlockInst insts[BLOCK_MAX_INSTS];
+#ifdef DYNAREC
+    uint16_t hits;      /*Number of times the block was interpreted*/
+    bool no_native;     /*Set if the block is not worth or not allowed to compile*/
+    NativeBlock native; /*Compiled block, NULL until the block is hot*/
+#endif
+} Block;
+
+typedef struct BlockCache {
+    uint32_t breakpoint; /*Blocks end in front of the breakpoint they were decoded with*/
+    Block blocks[BLOCK_CACHE_SIZE];
+#ifdef DYNAREC
+    uint8_t *code;       /*Executable buffer holding the compiled blocks*/
+    uint32_t code_used;  /*Bytes of the buffer handed out so far*/
+    CPU *shadow;         /*Scratch copy of the CPU for DYNAREC_VERIFY*/
+    uint8_t *shadow_ram; /*Its copy of the cartridge RAM and dirty pages*/
+    uint32_t shadow_ram_size;
+#endif
+} BlockCache;
+
+Block *get_block(CPU *cpu, uint16_t pc);
+
+#ifdef DYNAREC
+/* Dynamic recompiler */
+#define DYNAREC_HOT_HITS 16
+#define DYNAREC_BUFFER_SIZE 0x400000 /*4 MiB*/
+
+void compile_block(CPU *cpu, Block *block);
+void run_native(CPU *cpu, Block *block);
+void free_dynarec(BlockCache *cache);
+#endif
@@ -0,0 +1,96 @@
+#include <stddef.h>
+#include <stdint.h>
+
+/* Memory bus
+ *
+ * The address space is split into PAGE_COUNT pages of PAGE_SIZE bytes.
+ * For every page the bus holds a pointer to the host memory behind it,
+ * separately for reads and writes, so mem_read() and mem_write() are a
+ * table lookup and a load or store. Where that pointer is NULL the access
+ * goes to the page's handler instead, which is how I/O registers, MBC
+ * registers and read-only ROM are modelled without costing plain RAM and
+ * ROM accesses anything.
+ *
+ * Handlers are responsible for dropping cached code they change or remap,
+ * mem_write() only does that for writes that go straight to memory.
+ *
+ * With FASTMEM, the CPU also gets a 64 KiB aligned host region that mirrors
+ * the address space (fastmem.c). Wherever a host page of it can be mapped
+ * to the same memory the bus maps there, mem_read() and mem_write() skip
+ * the page table and access base[addr] directly. Everything else, such as
+ * the page with OAM and the I/O registers, MBC registers and ROM writes,
+ * takes the bus. The bits of fast_reads and fast_writes tell which is which,
+ * so nothing has to be trapped. Memory the bus maps has to come from
+ * alloc_memory() for fastmem to be able to mirror it.
+ *
+ * This header is included by cpu.h.
+ */
+
+#define PAGE_SIZE 0x100
+#define PAGE_COUNT 0x100
+
+#define FASTMEM_WINDOW_SHIFT 12 /*Mirrored in host pages of 4 KiB*/
+#define FASTMEM_WINDOW (1 << FASTMEM_WINDOW_SHIFT)
+#define FASTMEM_WINDOWS 16
+
+/* Memory map */
+#define ROM_START 0x0000
+#define VRAM_START 0x8000
+#define SRAM_START 0xA000
+#define WRAM_START 0xC000
+#define ECHO_START 0xE000
+#define OAM_START 0xFE00
+#define IO_START 0xFF00
+#define HRAM_START 0xFF80
+
+#define ROM_SIZE 0x8000
+#define VRAM_SIZE 0x2000
+#define SRAM_SIZE 0x2000
+#define WRAM_SIZE 0x2000
+#define ECHO_SIZE 0x1E00 /*Mirrors the start of WRAM*/
+
+typedef struct CPU CPU;
+
+typedef uint8_t (*BusRead)(CPU *cpu, uint16_t addr);
+typedef void (*BusWrite)(CPU *cpu, uint16_t addr, uint8_t val);
+
+typedef struct {
+    const uint8_t *read_pages[PAGE_COUNT]; /*Host memory behind a page, NULL to use read_handlers*/
+    uint8_t *write_pages[PAGE_COUNT];      /*Host memory behind a page, NULL to use write_handlers*/
+    BusRead read_handlers[PAGE_COUNT];
+    BusWrite write_handlers[PAGE_COUNT];
+} Bus;
+
+/* Backing memory of a CPU, allocated in one piece with every region sized
+ * to the part of the address space it backs. Echo RAM has no storage of
+ * its own, its pages point into wram. The bus mapping it comes last, so
+ * that the regions before it stay aligned and CPU stays small.
+ */
+typedef struct {
+    uint8_t rom[ROM_SIZE];
+    uint8_t vram[VRAM_SIZE];
+    uint8_t sram[SRAM_SIZE]; /*External cartridge RAM*/
+    uint8_t wram[WRAM_SIZE];
+    uint8_t oam[PAGE_SIZE];  /*OAM and the unusable area behind it*/
+    uint8_t high[PAGE_SIZE]; /*I/O registers, HRAM and IE*/
+    Bus bus;
+} Memory;
+
+/* Size of the regions of Memory, i.e. everything in front of the bus */
+#define MEMORY_REGIONS_SIZE offsetof(Memory, bus)
+
+void map_memory(CPU *cpu);
+void map_pages(CPU *cpu, uint8_t page, uint16_t count, const uint8_t *read, uint8_t *write);
+void map_handlers(CPU *cpu, uint8_t page, uint16_t count, BusRead read, BusWrite write);
+void rebase_bus(Bus *bus, const uint8_t *from, uint8_t *to, uint32_t size);
+uint8_t open_bus_read(CPU *cpu, uint16_t addr);
+void open_bus_write(CPU *cpu, uint16_t addr, uint8_t val);
+
+void *alloc_memory(size_t size);
+void free_memory(void *memory, size_t size);
+#ifdef FASTMEM
+void init_fastmem(CPU *cpu);
+void sync_fastmem(CPU *cpu, uint8_t page, uint16_t count);
+void forget_fastmem(CPU *cpu);
+void free_fastmem(CPU *cpu);
+#endif
@@ -0,0 +1,118 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Cartridges
+ *
+ * load_cartridge() maps a ROM file read-only and parses its header. The
+ * mapping is never written to, so every CPU the cartridge is inserted into
+ * reads the same physical pages, and so does any other process that maps
+ * the same file. Nothing of the ROM is copied per instance.
+ *
+ * A cartridge has to outlive every CPU it is inserted into.
+ *
+ * Memory bank controllers (mbc.c) are per CPU. Their registers sit on the
+ * ROM pages, so every write to ROM goes to the MBC's write handler, and a
+ * bank switch only points the pages of the switched window at the selected
+ * bank of the mapped ROM or of the cartridge RAM. Nothing is copied and
+ * loads and stores keep going straight to memory.
+ *
+ * Battery-backed RAM can be mapped from a save file with attach_save().
+ * Pages of it start out with a write handler that marks them dirty and
+ * maps them writable, so only the first write to a page between two
+ * flush_save() calls costs anything, and a flush only writes back the
+ * pages marked dirty. A crash loses at most what was written since the
+ * last flush.
+ *
+ * The MBC3 real-time clock (rtc.c) doesn't tick. It keeps its registers as
+ * of some point in time along with when that was, and only brings them up to
+ * date when the game latches or writes them. By default it follows the
+ * host's clock, set_rtc_clock() makes it follow the emulated cycles instead
+ * so replays see the same time.
+ *
+ * This header needs CPU, so include it after cpu.h.
+ */
+
+#define ROM_BANK_SIZE 0x4000
+#define RAM_BANK_SIZE 0x2000
+
+/* Cartridge header */
+#define HEADER_TITLE 0x0134
+#define HEADER_TITLE_SIZE 16
+#define HEADER_TYPE 0x0147
+#define HEADER_ROM_SIZE 0x0148
+#define HEADER_RAM_SIZE 0x0149
+#define HEADER_CHECKSUM 0x014D
+#define HEADER_GLOBAL_CHECKSUM 0x014E
+#define HEADER_END 0x0150
+
+#define MBC2_RAM_SIZE 0x200 /*512 4-bit cells built into the MBC*/
+
+/* MBC3 clock registers, selected through the RAM bank register */
+#define RTC_SECONDS 0x08
+#define RTC_MINUTES 0x09
+#define RTC_HOURS 0x0A
+#define RTC_DAYS_LOW 0x0B
+#define RTC_DAYS_HIGH 0x0C /*Bit 0 is bit 8 of the day counter*/
+#define RTC_REGISTER_COUNT 5
+#define RTC_HALT 0x40  /*Days high bit that stops the clock*/
+#define RTC_CARRY 0x80 /*Days high bit set when the day counter overflowed*/
+
+enum MbcKind { MBC_NONE, MBC_1, MBC_2, MBC_3, MBC_5 };  // NOLINT
+
+typedef struct Cartridge {
+    const uint8_t *rom; /*Read-only mapping of the ROM file*/
+    size_t rom_size;
+    uint16_t rom_banks; /*16 KiB banks*/
+    uint8_t ram_banks;  /*8 KiB banks of external RAM*/
+    uint8_t type;
+    uint8_t mbc;              /*enum MbcKind*/
+    bool battery;             /*RAM keeps its contents, see attach_save()*/
+    uint16_t global_checksum; /*As stored in the header, hardware never checks it*/
+    char title[HEADER_TITLE_SIZE + 1];
+} Cartridge;
+
+typedef struct {
+    uint8_t second; /*Clock registers as of base_cycles or base_time*/
+    uint8_t minute;
+    uint8_t hour;
+    uint16_t days;          /*9 bits*/
+    uint64_t base_cycles;   /*cpu->cycles at the start of the running second*/
+    int64_t base_time;      /*Host time at the start of the running second*/
+    uint64_t halted_cycles; /*cpu->cycles when the clock was halted*/
+    int64_t halted_time;    /*Host time when the clock was halted*/
+    bool emulated;          /*Follow cpu->cycles instead of the host's clock*/
+    bool halted;
+    bool carry;
+    uint8_t latch; /*Last value written to the latch register*/
+    uint8_t latched[RTC_REGISTER_COUNT];
+} Rtc;
+
+/* Bank registers of a CPU's MBC */
+typedef struct Mbc {
+    const Cartridge *cart;
+    bool ram_enabled;
+    bool mode;          /*MBC1 banking mode*/
+    uint8_t bank_low;   /*Lower ROM bank register*/
+    uint8_t bank_high;  /*Upper ROM bank (MBC1, MBC5) register*/
+    uint8_t ram_select; /*RAM bank mapped at 0xA000, MBC3 also selects RTC registers with it*/
+    uint16_t rom_bank;  /*Bank mapped at 0x4000*/
+    uint16_t rom_bank0; /*Bank mapped at 0x0000, only MBC1 moves it*/
+    uint8_t *ram;
+    uint32_t ram_size;
+    bool *dirty; /*Per page of ram, NULL unless ram is mapped from a save file*/
+    Rtc rtc;     /*MBC3 only*/
+} Mbc;
+
+Cartridge *load_cartridge(const char *path);
+void free_cartridge(Cartridge *cart);
+bool insert_cartridge(CPU *cpu, Cartridge *cart);
+bool init_mbc(CPU *cpu, const Cartridge *cart);
+uint16_t mbc_bank(const Mbc *mbc, uint16_t addr);
+bool attach_save(CPU *cpu, const char *path);
+bool flush_save(CPU *cpu);
+void init_rtc(CPU *cpu);
+void set_rtc_clock(CPU *cpu, bool emulated);
+void latch_rtc(CPU *cpu);
+uint8_t rtc_read(CPU *cpu, uint16_t addr);
+void rtc_write(CPU *cpu, uint16_t addr, uint8_t val);
@@ -1,15 +1,25 @@
+#include <stddef.h>
 #include <stdint.h>
 
+#include "bus.h"
 #include "instructions.h"
+#include "io.h"
 #include "registers.h"
+#include "scheduler.h"
 
-#define MEMORY_SIZE 0xFFFF
+#define MEMORY_SIZE 0x10000 /*Size of the address space*/
 
 #define HBYTE_M 0xF
 #define BYTE_M 0xFF
 #define BBYTE_M 0xFFFF
 #define UPPER_BYTE_M 0xFF00
 
+#define FRAME_CYCLES 70224 /*T-cycles per frame at ~59.7 Hz*/
+#define CLOCK_HZ 4194304   /*T-cycles per second*/
+#define NO_BREAKPOINT 0x10000
+
+#define AOT_ROM_SIZE 0x8000 /*Cartridge ROM covered by AOT images*/
+
 #define MSB_IDX 7
 #define PREFIX_BYTE 0xCB
 #define BYTE_SIZE 8
@@ -22,20 +32,112 @@
         ((byte) & 0x10 ? '1' : '0'), ((byte) & 0x08 ? '1' : '0'), ((byte) & 0x04 ? '1' : '0'), \
         ((byte) & 0x02 ? '1' : '0'), ((byte) & 0x01 ? '1' : '0')
 
+/* Operations whose flags can be evaluated lazily
+ * (ADC is recorded as ADD and SBC and CP are recorded as SUB)
+ */
+enum FlagOp {  // NOLINT
+    FLAG_OP_NONE,
+    FLAG_OP_ADD,
+    FLAG_OP_SUB,
+    FLAG_OP_LOGIC,
+    FLAG_OP_INC,
+    FLAG_OP_DEC,
+};
+
+/* Record of the last flag-setting operation, from which the flags
+ * can be computed once they are actually needed.
+ */
 typedef struct {
+    uint8_t op;    /*enum FlagOp*/
+    uint8_t lhs;   /*Value of A or the INC/DEC operand*/
+    uint8_t rhs;   /*Operand of the ALU operation*/
+    uint8_t carry; /*Carry in for ADC/SBC or the untouched carry for INC/DEC*/
+    uint8_t res;
+} LazyFlags;
+
+typedef struct CPU {
     Registers registers;
-    FlagRegister flag_reg;
-    uint16_t prog_count;
-    uint16_t stack_pointer;
-    uint8_t memory[MEMORY_SIZE];
+#ifdef LAZY_FLAGS
+    LazyFlags lazy_flags;
+#endif
+    uint64_t cycles; /*T-cycles executed since power on*/
+    Memory *memory;  /*The bus and everything it maps, kept out of CPU so it stays small*/
+#ifdef FASTMEM
+    /* Mirror of the address space, see bus.h */
+    uint8_t *fastmem;     /*NULL if the host can't provide one*/
+    uint16_t fast_reads;  /*Bit per window of fastmem that reads can use*/
+    uint16_t fast_writes; /*Bit per window of fastmem that writes can use*/
+#endif
+
+    /* Run control */
+    uint32_t breakpoint; /*run_cycles() stops before executing this address*/
+    bool stop;           /*Set by stop_cpu()*/
+    uint64_t limit;      /*Where the CPU has to stop next, see pending_work()*/
+    Scheduler scheduler; /*Pending events, see scheduler.h*/
+
+    /* Interrupts, see io.h */
+    bool ime;      /*Interrupt master enable*/
+    bool ei_delay; /*EI was executed, IME gets set after the next instruction*/
+    bool halted;   /*Waiting for an interrupt in HALT or STOP*/
+
+    Timer timer; /*See io.h*/
+
+#ifdef BLOCK_DISPATCH
+    /* Decoded block cache, see block_cache.h */
+    struct BlockCache *block_cache;
+    bool code_written;              /*Set when a write invalidated cached blocks*/
+    uint8_t code_pages[PAGE_COUNT]; /*Set for pages that cached blocks were decoded from*/
+#endif
+#ifdef AOT
+    struct AotRuntime *aot; /*Loaded AOT image, see aot.h*/
+#endif
+
+#ifdef FASTMEM
+    const uint8_t *fast_sources[FASTMEM_WINDOWS]; /*Memory mapped into each window of fastmem*/
+#endif
+    struct Cartridge *cartridge; /*Inserted cartridge, see cartridge.h*/
+    struct Mbc *mbc;             /*Bank registers of the inserted cartridge*/
 } CPU;
 
 CPU new_cpu(void);
+void free_cpu(CPU *cpu);
+void load_program(CPU *cpu, const uint8_t *program, size_t size);
 
 /* Instruction execution */
-void step(CPU *cpu);
+uint32_t step(CPU *cpu);
+uint32_t run_cycles(CPU *cpu, uint32_t budget);
+uint32_t run_frame(CPU *cpu);
 uint16_t execute(CPU *cpu, const Instruction *instruction);
 
+/* lower_limit makes the running CPU stop once cpu->cycles reaches time,
+ * leaving a running block after the current instruction if need be.
+ */
+static inline void lower_limit(CPU *cpu, uint64_t time) {
+    if (time < cpu->limit) {
+        cpu->limit = time;
+#ifdef BLOCK_DISPATCH
+        // Blocks that fit in before the limit only look at this
+        cpu->code_written = true;
+#endif
+    }
+}
+
+/* pending_work is the one test the dispatch loops make after every
+ * instruction or block. Everything that needs run_until() to step in, be it
+ * an event, the deadline, an interrupt that can be taken, EI or stop_cpu(),
+ * lowers cpu->limit to when that is, and the breakpoint is folded in
+ * without a branch of its own.
+ */
+static inline bool pending_work(const CPU *cpu) {
+    return (cpu->cycles >= cpu->limit) | (cpu->registers.pc == cpu->breakpoint);
+}
+
+/* stop_cpu makes run_cycles() return after the current instruction or block */
+static inline void stop_cpu(CPU *cpu) {
+    cpu->stop = true;
+    lower_limit(cpu, cpu->cycles);
+}
+
 /* Register interactions */
 uint16_t get_reg(CPU *cpu, enum RegisterName reg);
 void set_reg(CPU *cpu, enum RegisterName reg, uint16_t val);
@@ -43,14 +145,198 @@ void print_reg(CPU *cpu, enum RegisterName reg);
 void print_regs(CPU *cpu);
 void update_flags(CPU *cpu, bool zero, bool subtract, bool half_carry, bool carry);
 
+/* Flag interactions */
+void sync_flags(CPU *cpu);
+
+/* eval_flags returns the value of F after the recorded operation */
+static inline uint8_t eval_flags(const LazyFlags *lazy) {
+    uint8_t lhs = lazy->lhs;
+    uint8_t rhs = lazy->rhs;
+    uint8_t car = lazy->carry;
+    uint8_t zero = lazy->res == 0 ? ZERO_FLAG_M : 0;
+
+    switch (lazy->op) {
+        case FLAG_OP_ADD:
+            return zero |
+                   ((lhs & HBYTE_M) + (rhs & HBYTE_M) + car > HBYTE_M ? HALF_CARRY_FLAG_M : 0) |
+                   (lhs + rhs + car > BYTE_M ? CARRY_FLAG_M : 0);
+        case FLAG_OP_SUB:
+            return zero | SUBTRACT_FLAG_M |
+                   ((lhs & HBYTE_M) < (rhs & HBYTE_M) + car ? HALF_CARRY_FLAG_M : 0) |
+                   (lhs < rhs + car ? CARRY_FLAG_M : 0);
+        case FLAG_OP_LOGIC:
+            return zero | HALF_CARRY_FLAG_M;
+        case FLAG_OP_INC:
+            return ((lhs & HBYTE_M) + 1 > HBYTE_M ? HALF_CARRY_FLAG_M : 0) |
+                   (car ? CARRY_FLAG_M : 0);
+        case FLAG_OP_DEC:
+            return zero | SUBTRACT_FLAG_M | ((lhs & HBYTE_M) >= 1 ? HALF_CARRY_FLAG_M : 0) |
+                   (car ? CARRY_FLAG_M : 0);
+        default:
+            return zero;
+    }
+}
+
+/* drop_flags discards a pending record once F is overwritten */
+static inline void drop_flags(CPU *cpu) {
+#ifdef LAZY_FLAGS
+    cpu->lazy_flags.op = FLAG_OP_NONE;
+#else
+    (void)cpu;
+#endif
+}
+
+/* Lazy flags mode only records the operation, the eager mode
+ * evaluates and stores the flags right away.
+ */
+static inline void record_flags(CPU *cpu, enum FlagOp op, uint8_t lhs, uint8_t rhs, uint8_t carry,
+                                uint8_t res) {
+    LazyFlags lazy = {op, lhs, rhs, carry, res};
+#ifdef LAZY_FLAGS
+    cpu->lazy_flags = lazy;
+#else
+    cpu->registers.f = eval_flags(&lazy);
+#endif
+}
+
+static inline bool zero_flag(const CPU *cpu) {
+#ifdef LAZY_FLAGS
+    switch (cpu->lazy_flags.op) {
+        case FLAG_OP_NONE:
+            break;
+        case FLAG_OP_INC:
+            return false;
+        default:
+            return cpu->lazy_flags.res == 0;
+    }
+#endif
+    return (cpu->registers.f & ZERO_FLAG_M) != 0;
+}
+
+static inline bool carry_flag(const CPU *cpu) {
+#ifdef LAZY_FLAGS
+    const LazyFlags *lazy = &cpu->lazy_flags;
+    switch (lazy->op) {
+        case FLAG_OP_NONE:
+            break;
+        case FLAG_OP_ADD:
+            return lazy->lhs + lazy->rhs + lazy->carry > BYTE_M;
+        case FLAG_OP_SUB:
+            return lazy->lhs < lazy->rhs + lazy->carry;
+        case FLAG_OP_LOGIC:
+            return false;
+        default:
+            return lazy->carry;
+    }
+#endif
+    return (cpu->registers.f & CARRY_FLAG_M) != 0;
+}
+
 /* Memory interactions */
 uint8_t read_byte(CPU *cpu);
 uint16_t read_bbyte(CPU *cpu);
+void invalidate_code_page(CPU *cpu, uint8_t page);
+void free_block_cache(CPU *cpu);
+void invalidate_aot_page(CPU *cpu, uint8_t page);
+void free_aot(CPU *cpu);
+void free_mbc(CPU *cpu);
+
+/* Every access to the address space goes through the bus, see bus.h */
+static inline uint8_t bus_read(CPU *cpu, uint16_t addr) {
+    const uint8_t *page = cpu->memory->bus.read_pages[addr >> BYTE_SIZE];
+    if (page == NULL) {
+        return cpu->memory->bus.read_handlers[addr >> BYTE_SIZE](cpu, addr);
+    }
+    return page[addr & BYTE_M];
+}
+
+static inline uint8_t mem_read(CPU *cpu, uint16_t addr) {
+#ifdef FASTMEM
+    if ((cpu->fast_reads >> (addr >> FASTMEM_WINDOW_SHIFT)) & 1) {
+        return cpu->fastmem[addr];
+    }
+#endif
+    return bus_read(cpu, addr);
+}
+
+/* Writes that go straight to memory also drop the cached blocks
+ * and AOT compiled code they overwrite.
+ */
+static inline void wrote_memory(CPU *cpu, uint16_t addr) {
+    (void)cpu;
+    (void)addr;
+#ifdef BLOCK_DISPATCH
+    if (cpu->code_pages[addr >> BYTE_SIZE]) {
+        invalidate_code_page(cpu, addr >> BYTE_SIZE);
+    }
+#endif
+#ifdef AOT
+    if (addr < AOT_ROM_SIZE && cpu->aot != NULL) {
+        invalidate_aot_page(cpu, addr >> BYTE_SIZE);
+    }
+#endif
+}
+
+static inline void mem_write(CPU *cpu, uint16_t addr, uint8_t val) {
+#ifdef FASTMEM
+    if ((cpu->fast_writes >> (addr >> FASTMEM_WINDOW_SHIFT)) & 1) {
+        cpu->fastmem[addr] = val;
+        wrote_memory(cpu, addr);
+        return;
+    }
+#endif
+    uint8_t *page = cpu->memory->bus.write_pages[addr >> BYTE_SIZE];
+    if (page == NULL) {
+        cpu->memory->bus.write_handlers[addr >> BYTE_SIZE](cpu, addr, val);
+        return;
+    }
+    page[addr & BYTE_M] = val;
+    wrote_memory(cpu, addr);
+}
+
+/* interrupt_pending tells whether any interrupt is both requested and enabled */
+static inline bool interrupt_pending(const CPU *cpu) {
+    const uint8_t *high = cpu->memory->high;
+    return (high[IO_IE & BYTE_M] & high[IO_IF & BYTE_M] & INT_M) != 0;
+}
 
 /* Stack interactions */
 void stack_push(CPU *cpu, uint16_t val);
 uint16_t stack_pop(CPU *cpu);
 
+/* Instruction implementations on fetched operands */
+void alu_add(CPU *cpu, uint8_t val);
+void alu_add_hl(CPU *cpu, uint16_t val);
+void alu_adc(CPU *cpu, uint8_t val);
+void alu_sub(CPU *cpu, uint8_t val);
+void alu_sbc(CPU *cpu, uint8_t val);
+void alu_and(CPU *cpu, uint8_t val);
+void alu_or(CPU *cpu, uint8_t val);
+void alu_xor(CPU *cpu, uint8_t val);
+void alu_cp(CPU *cpu, uint8_t val);
+uint8_t alu_inc(CPU *cpu, uint8_t val);
+uint8_t alu_dec(CPU *cpu, uint8_t val);
+
+/* Same as above without touching the flags */
+void alu_add_nf(CPU *cpu, uint8_t val);
+void alu_add_hl_nf(CPU *cpu, uint16_t val);
+void alu_adc_nf(CPU *cpu, uint8_t val);
+void alu_sub_nf(CPU *cpu, uint8_t val);
+void alu_sbc_nf(CPU *cpu, uint8_t val);
+void alu_and_nf(CPU *cpu, uint8_t val);
+void alu_or_nf(CPU *cpu, uint8_t val);
+void alu_xor_nf(CPU *cpu, uint8_t val);
+
+void alu_bit(CPU *cpu, uint8_t bit_index, uint8_t val);
+uint8_t alu_srl(CPU *cpu, uint8_t val);
+uint8_t alu_rr(CPU *cpu, uint8_t val);
+uint8_t alu_rl(CPU *cpu, uint8_t val);
+uint8_t alu_rrc(CPU *cpu, uint8_t val);
+uint8_t alu_rlc(CPU *cpu, uint8_t val);
+uint8_t alu_sra(CPU *cpu, uint8_t val);
+uint8_t alu_sla(CPU *cpu, uint8_t val);
+uint8_t alu_swap(CPU *cpu, uint8_t val);
+
 /* Instruction implementations */
 void add(CPU *cpu, enum Operand source);
 void add_hl(CPU *cpu, enum Operand source);
@@ -122,3 +408,10 @@ void pop(CPU *cpu, enum Operand target);
 
 uint16_t call(CPU *cpu, enum JumpCondition jump_cond);
 uint16_t ret(CPU *cpu, enum JumpCondition jump_cond);
+uint16_t reti(CPU *cpu);
+uint16_t rst(CPU *cpu, uint8_t vector);
+
+void di(CPU *cpu);
+void ei(CPU *cpu);
+uint16_t halt(CPU *cpu);
+uint16_t stop(CPU *cpu);
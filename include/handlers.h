@@ -0,0 +1,418 @@
+#include "cpu.h"
+#include "opcodes.h"
+
+/* Per-opcode handlers
+ *
+ * For every entry of the opcode map a handler op_<opcode> (or pf_op_<opcode>
+ * for prefixed opcodes) is generated. A handler executes its instruction with
+ * the operands of the opcode map baked in and returns the next program counter,
+ * just like execute() does for a decoded Instruction.
+ *
+ * Operands are resolved by the preprocessor: GET_<operand> reads and
+ * SET_<operand>(val) writes the register field or memory cell behind an
+ * operand, so there is no switch over enum Operand left at runtime.
+ * The generic implementations in execute.c stay around for execute().
+ *
+ * The handlers are static inline so that interpreter loops which include this
+ * header can inline them into their dispatch code.
+ *
+ * The ALU opcodes additionally get a flag-free handler nf_op_<opcode>, which
+ * computes the result but leaves F (and a pending lazy flag record) alone.
+ * The block cache uses them where the flags are dead.
+ */
+
+typedef uint16_t (*OpHandler)(CPU *cpu);
+
+extern const OpHandler op_handlers[OPCODE_COUNT];
+extern const OpHandler pf_op_handlers[OPCODE_COUNT];
+extern const OpHandler nf_op_handlers[OPCODE_COUNT]; /*NULL outside of ALU_OPCODES*/
+
+static inline uint16_t hl_post_inc(CPU *cpu) {
+    return cpu->registers.hl++;
+}
+
+static inline uint16_t hl_post_dec(CPU *cpu) {
+    return cpu->registers.hl--;
+}
+
+// NOLINTBEGIN
+/* Operand accessors */
+#define GET_O_A cpu->registers.a
+#define SET_O_A(val) cpu->registers.a = (val)
+#define GET_O_B cpu->registers.b
+#define SET_O_B(val) cpu->registers.b = (val)
+#define GET_O_C cpu->registers.c
+#define SET_O_C(val) cpu->registers.c = (val)
+#define GET_O_D cpu->registers.d
+#define SET_O_D(val) cpu->registers.d = (val)
+#define GET_O_E cpu->registers.e
+#define SET_O_E(val) cpu->registers.e = (val)
+#define GET_O_F (sync_flags(cpu), cpu->registers.f)
+#define SET_O_F(val) (drop_flags(cpu), cpu->registers.f = (val))
+#define GET_O_H cpu->registers.h
+#define SET_O_H(val) cpu->registers.h = (val)
+#define GET_O_L cpu->registers.l
+#define SET_O_L(val) cpu->registers.l = (val)
+#define GET_O_AF (sync_flags(cpu), cpu->registers.af)
+#define SET_O_AF(val) (drop_flags(cpu), cpu->registers.af = (val))
+#define GET_O_BC cpu->registers.bc
+#define SET_O_BC(val) cpu->registers.bc = (val)
+#define GET_O_DE cpu->registers.de
+#define SET_O_DE(val) cpu->registers.de = (val)
+#define GET_O_HL cpu->registers.hl
+#define SET_O_HL(val) cpu->registers.hl = (val)
+#define GET_O_SP cpu->registers.sp
+#define SET_O_SP(val) cpu->registers.sp = (val)
+#define GET_O_C_IND mem_read(cpu, UPPER_BYTE_M | cpu->registers.c)
+#define SET_O_C_IND(val) mem_write(cpu, UPPER_BYTE_M | cpu->registers.c, val)
+#define GET_O_BC_IND mem_read(cpu, cpu->registers.bc)
+#define SET_O_BC_IND(val) mem_write(cpu, cpu->registers.bc, val)
+#define GET_O_DE_IND mem_read(cpu, cpu->registers.de)
+#define SET_O_DE_IND(val) mem_write(cpu, cpu->registers.de, val)
+#define GET_O_HL_IND mem_read(cpu, cpu->registers.hl)
+#define SET_O_HL_IND(val) mem_write(cpu, cpu->registers.hl, val)
+#define GET_O_HL_INC_IND mem_read(cpu, hl_post_inc(cpu))
+#define SET_O_HL_INC_IND(val) mem_write(cpu, hl_post_inc(cpu), val)
+#define GET_O_HL_DEC_IND mem_read(cpu, hl_post_dec(cpu))
+#define SET_O_HL_DEC_IND(val) mem_write(cpu, hl_post_dec(cpu), val)
+#define GET_O_D8 read_byte(cpu)
+#define GET_O_D16 read_bbyte(cpu)
+#define GET_O_A8_IND mem_read(cpu, UPPER_BYTE_M | read_byte(cpu))
+#define SET_O_A8_IND(val) mem_write(cpu, UPPER_BYTE_M | read_byte(cpu), val)
+#define GET_O_A16_IND mem_read(cpu, read_bbyte(cpu))
+#define SET_O_A16_IND(val) mem_write(cpu, read_bbyte(cpu), val)
+
+/* Arithmetic Instructions */
+#define HANDLE_ADD(bit_index, jump_cond, target, source) \
+    alu_add(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_ADD_HL(bit_index, jump_cond, target, source) \
+    alu_add_hl(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_ADD_IND(bit_index, jump_cond, target, source) \
+    alu_add(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_ADD_D8(bit_index, jump_cond, target, source) \
+    alu_add(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_ADC(bit_index, jump_cond, target, source) \
+    alu_adc(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_ADC_IND(bit_index, jump_cond, target, source) \
+    alu_adc(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_ADC_D8(bit_index, jump_cond, target, source) \
+    alu_adc(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_SUB(bit_index, jump_cond, target, source) \
+    alu_sub(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_SUB_IND(bit_index, jump_cond, target, source) \
+    alu_sub(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_SUB_D8(bit_index, jump_cond, target, source) \
+    alu_sub(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_SBC(bit_index, jump_cond, target, source) \
+    alu_sbc(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_SBC_IND(bit_index, jump_cond, target, source) \
+    alu_sbc(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_SBC_D8(bit_index, jump_cond, target, source) \
+    alu_sbc(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_AND(bit_index, jump_cond, target, source) \
+    alu_and(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_AND_IND(bit_index, jump_cond, target, source) \
+    alu_and(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_AND_D8(bit_index, jump_cond, target, source) \
+    alu_and(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_OR(bit_index, jump_cond, target, source) \
+    alu_or(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_OR_IND(bit_index, jump_cond, target, source) \
+    alu_or(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_OR_D8(bit_index, jump_cond, target, source) \
+    alu_or(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_XOR(bit_index, jump_cond, target, source) \
+    alu_xor(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_XOR_IND(bit_index, jump_cond, target, source) \
+    alu_xor(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_XOR_D8(bit_index, jump_cond, target, source) \
+    alu_xor(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_CP(bit_index, jump_cond, target, source) \
+    alu_cp(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define HANDLE_CP_IND(bit_index, jump_cond, target, source) \
+    alu_cp(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define HANDLE_CP_D8(bit_index, jump_cond, target, source) \
+    alu_cp(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define HANDLE_INC(bit_index, jump_cond, target, source) \
+    /* Flags are only affected for byte registers */     \
+    if (source < O_AF) {                                 \
+        SET_##source(alu_inc(cpu, GET_##source));        \
+    } else {                                             \
+        SET_##source(GET_##source + 1);                  \
+    }                                                    \
+    return cpu->registers.pc + 1;
+#define HANDLE_INC_IND(bit_index, jump_cond, target, source) \
+    SET_##source(alu_inc(cpu, GET_##source));                \
+    return cpu->registers.pc + 1;
+#define HANDLE_DEC(bit_index, jump_cond, target, source) \
+    /* Flags are only affected for byte registers */     \
+    if (source < O_AF) {                                 \
+        SET_##source(alu_dec(cpu, GET_##source));        \
+    } else {                                             \
+        SET_##source(GET_##source - 1);                  \
+    }                                                    \
+    return cpu->registers.pc + 1;
+#define HANDLE_DEC_IND(bit_index, jump_cond, target, source) \
+    SET_##source(alu_dec(cpu, GET_##source));                \
+    return cpu->registers.pc + 1;
+#define HANDLE_CCF(bit_index, jump_cond, target, source) \
+    ccf(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_SCF(bit_index, jump_cond, target, source) \
+    scf(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_RRA(bit_index, jump_cond, target, source) \
+    rra(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_RLA(bit_index, jump_cond, target, source) \
+    rla(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_RRCA(bit_index, jump_cond, target, source) \
+    rrca(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_RLCA(bit_index, jump_cond, target, source) \
+    rlca(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_CPL(bit_index, jump_cond, target, source) \
+    cpl(cpu);                                            \
+    return cpu->registers.pc + 1;
+
+/* Prefix Instructions */
+#define HANDLE_BIT(bit_index, jump_cond, target, source) \
+    alu_bit(cpu, bit_index, GET_##target);               \
+    return cpu->registers.pc + 2;
+#define HANDLE_RESET(bit_index, jump_cond, target, source)     \
+    SET_##target((uint8_t)(GET_##target & ~(1 << bit_index))); \
+    return cpu->registers.pc + 2;
+#define HANDLE_SET(bit_index, jump_cond, target, source)      \
+    SET_##target((uint8_t)(GET_##target | (1 << bit_index))); \
+    return cpu->registers.pc + 2;
+#define HANDLE_SRL(bit_index, jump_cond, target, source) \
+    SET_##target(alu_srl(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+#define HANDLE_RR(bit_index, jump_cond, target, source) \
+    SET_##target(alu_rr(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+#define HANDLE_RL(bit_index, jump_cond, target, source) \
+    SET_##target(alu_rl(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+#define HANDLE_RRC(bit_index, jump_cond, target, source) \
+    SET_##target(alu_rrc(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+#define HANDLE_RLC(bit_index, jump_cond, target, source) \
+    SET_##target(alu_rlc(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+#define HANDLE_SRA(bit_index, jump_cond, target, source) \
+    SET_##target(alu_sra(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+#define HANDLE_SLA(bit_index, jump_cond, target, source) \
+    SET_##target(alu_sla(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+#define HANDLE_SWAP(bit_index, jump_cond, target, source) \
+    SET_##target(alu_swap(cpu, GET_##target));            \
+    return cpu->registers.pc + 2;
+
+/* Jump Instructions */
+#define HANDLE_JP(bit_index, jump_cond, target, source) \
+    return jp(cpu, jump_cond);
+#define HANDLE_JP_HL(bit_index, jump_cond, target, source) \
+    return jp_hl(cpu);
+#define HANDLE_JR(bit_index, jump_cond, target, source) \
+    return jr(cpu, jump_cond);
+
+/* Load Instructions */
+#define HANDLE_LD_REG(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                             \
+    return cpu->registers.pc + 1;
+#define HANDLE_LD_D8(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                            \
+    return cpu->registers.pc + 2;
+#define HANDLE_LD_D16(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                             \
+    return cpu->registers.pc + 3;
+#define HANDLE_LD_D8_IND(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                                \
+    return cpu->registers.pc + 2;
+#define HANDLE_LD_IND(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                             \
+    return cpu->registers.pc + 1;
+#define HANDLE_LD_ADDR(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                              \
+    return cpu->registers.pc + 3;
+#define HANDLE_LD_INC(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                             \
+    return cpu->registers.pc + 1;
+#define HANDLE_LD_DEC(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                             \
+    return cpu->registers.pc + 1;
+#define HANDLE_LDH_IND(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                              \
+    return cpu->registers.pc + 2;
+#define HANDLE_LDH_ADDR(bit_index, jump_cond, target, source) \
+    SET_##target(GET_##source);                               \
+    return cpu->registers.pc + 2;
+
+/* Stack Instructions */
+#define HANDLE_PUSH(bit_index, jump_cond, target, source) \
+    stack_push(cpu, GET_##source);                        \
+    return cpu->registers.pc + 1;
+#define HANDLE_POP(bit_index, jump_cond, target, source) \
+    SET_##target(stack_pop(cpu));                        \
+    return cpu->registers.pc + 1;
+
+/* Call and Return Instructions */
+#define HANDLE_CALL(bit_index, jump_cond, target, source) \
+    return call(cpu, jump_cond);
+#define HANDLE_RET(bit_index, jump_cond, target, source) \
+    return ret(cpu, jump_cond);
+#define HANDLE_RETI(bit_index, jump_cond, target, source) \
+    return reti(cpu);
+#define HANDLE_RST(bit_index, jump_cond, target, source) \
+    return rst(cpu, bit_index);
+
+/* Interrupt and CPU Control Instructions */
+#define HANDLE_DI(bit_index, jump_cond, target, source) \
+    di(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_EI(bit_index, jump_cond, target, source) \
+    ei(cpu);                                            \
+    return cpu->registers.pc + 1;
+#define HANDLE_HALT(bit_index, jump_cond, target, source) \
+    return halt(cpu);
+#define HANDLE_STOP(bit_index, jump_cond, target, source) \
+    return stop(cpu);
+
+/* No Op Instruction */
+#define HANDLE_NOP(bit_index, jump_cond, target, source) \
+    return cpu->registers.pc + 1;
+
+/* Flag-free Arithmetic Instructions */
+#define NF_HANDLE_ADD(bit_index, jump_cond, target, source) \
+    alu_add_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_ADD_IND(bit_index, jump_cond, target, source) \
+    alu_add_nf(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_ADD_D8(bit_index, jump_cond, target, source) \
+    alu_add_nf(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_ADD_HL(bit_index, jump_cond, target, source) \
+    alu_add_hl_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_ADC(bit_index, jump_cond, target, source) \
+    alu_adc_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_ADC_IND(bit_index, jump_cond, target, source) \
+    alu_adc_nf(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_ADC_D8(bit_index, jump_cond, target, source) \
+    alu_adc_nf(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_SUB(bit_index, jump_cond, target, source) \
+    alu_sub_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_SUB_IND(bit_index, jump_cond, target, source) \
+    alu_sub_nf(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_SUB_D8(bit_index, jump_cond, target, source) \
+    alu_sub_nf(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_SBC(bit_index, jump_cond, target, source) \
+    alu_sbc_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_SBC_IND(bit_index, jump_cond, target, source) \
+    alu_sbc_nf(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_SBC_D8(bit_index, jump_cond, target, source) \
+    alu_sbc_nf(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_AND(bit_index, jump_cond, target, source) \
+    alu_and_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_AND_IND(bit_index, jump_cond, target, source) \
+    alu_and_nf(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_AND_D8(bit_index, jump_cond, target, source) \
+    alu_and_nf(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_OR(bit_index, jump_cond, target, source) \
+    alu_or_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_OR_IND(bit_index, jump_cond, target, source) \
+    alu_or_nf(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_OR_D8(bit_index, jump_cond, target, source) \
+    alu_or_nf(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_XOR(bit_index, jump_cond, target, source) \
+    alu_xor_nf(cpu, GET_##source);                          \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_XOR_IND(bit_index, jump_cond, target, source) \
+    alu_xor_nf(cpu, GET_##source);                              \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_XOR_D8(bit_index, jump_cond, target, source) \
+    alu_xor_nf(cpu, GET_##source);                             \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_CP(bit_index, jump_cond, target, source) \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_CP_IND(bit_index, jump_cond, target, source) \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_CP_D8(bit_index, jump_cond, target, source) \
+    return cpu->registers.pc + 2;
+#define NF_HANDLE_INC(bit_index, jump_cond, target, source) \
+    SET_##source(GET_##source + 1);                         \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_INC_IND(bit_index, jump_cond, target, source) \
+    SET_##source(GET_##source + 1);                             \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_DEC(bit_index, jump_cond, target, source) \
+    SET_##source(GET_##source - 1);                         \
+    return cpu->registers.pc + 1;
+#define NF_HANDLE_DEC_IND(bit_index, jump_cond, target, source) \
+    SET_##source(GET_##source - 1);                             \
+    return cpu->registers.pc + 1;
+
+#define DEFINE_HANDLER(opcode, kind, bit_index, jump_cond, target, source) \
+    static inline uint16_t op_##opcode(CPU *cpu) {                         \
+        HANDLE_##kind(bit_index, jump_cond, target, source)                \
+    }
+
+#define DEFINE_PF_HANDLER(opcode, kind, bit_index, jump_cond, target, source) \
+    static inline uint16_t pf_op_##opcode(CPU *cpu) {                         \
+        HANDLE_##kind(bit_index, jump_cond, target, source)                   \
+    }
+
+#define DEFINE_NF_HANDLER(opcode, kind, bit_index, jump_cond, target, source) \
+    static inline uint16_t nf_op_##opcode(CPU *cpu) {                         \
+        NF_HANDLE_##kind(bit_index, jump_cond, target, source)                \
+    }
+
+BASE_OPCODES(DEFINE_HANDLER)
+PREFIX_OPCODES(DEFINE_PF_HANDLER)
+ALU_OPCODES(DEFINE_NF_HANDLER)
+// NOLINTEND
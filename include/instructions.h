@@ -1,8 +1,9 @@
 #include <stdint.h>
 
 #define NOT_FOUND_INST {0, 0, 0, 0, 0}
+#define OPCODE_COUNT 256
 
-// TODO: JR, LD_SP, EI, DI, HALT, RST...
+// TODO: LD_SP, ADD_SP, LD_HL_SP, DAA...
 enum InstructionKind {  // NOLINT
     /* Arithmetic Instructions */
     ADD,    /*Add target to register A*/
@@ -81,6 +82,14 @@ enum InstructionKind {  // NOLINT
              on the stack*/
     RET,  /*Conditionally return from a function call by popping the previously stored PC from the
              stack and jumping to it*/
+    RETI, /*Return from an interrupt handler and enable interrupts*/
+    RST,  /*Call one of the fixed addresses 0x00, 0x08, ..., 0x38*/
+
+    /* Interrupt and CPU Control Instructions */
+    DI,   /*Disable interrupts*/
+    EI,   /*Enable interrupts after the next instruction*/
+    HALT, /*Wait for an interrupt*/
+    STOP, /*Reset DIV and wait for an interrupt*/
 
     /* No Op Instruction */
     NOP /*Do nothing*/
@@ -125,21 +134,46 @@ enum Operand {  // NOLINT
 
 // TODO: embed generic Instruction inside of specific
 // instructions like: ArithInstr, PrefixInstr, JumpInstr, LoadInstr ...
+//
+// NOTE: Every field is stored in a single byte so that an Instruction
+// packs into 5 bytes. The enums above all fit into a byte.
 typedef struct {
-    enum InstructionKind kind;
+    uint8_t kind; /*enum InstructionKind*/
 
     /* Prefix Instructions */
-    uint8_t bit_index;
+    uint8_t bit_index; /*RST keeps its target address here*/
 
     /* Jump Instructions */
-    enum JumpCondition jump_cond;
+    uint8_t jump_cond; /*enum JumpCondition*/
 
     /* Load Instructions */
-    enum Operand target;
-    enum Operand source;
+    uint8_t target; /*enum Operand*/
+    uint8_t source; /*enum Operand*/
 } Instruction;
 
 /* Instruction Decoding */
+extern const Instruction inst_table[OPCODE_COUNT];
+extern const Instruction pf_inst_table[OPCODE_COUNT];
+
+/* Cycle tables (in T-cycles) for the base and the 0xCB prefixed opcodes.
+ * Conditional jumps are listed with the cost of the branch not being taken,
+ * a taken branch adds the matching *_TAKEN_CYCLES on top.
+ */
+extern const uint8_t inst_cycles[OPCODE_COUNT];
+extern const uint8_t pf_inst_cycles[OPCODE_COUNT];
+
+/* Number of bytes the handlers advance the program counter by when an
+ * instruction does not jump. Opcodes that are not implemented yet advance
+ * it by one byte.
+ */
+extern const uint8_t inst_lengths[OPCODE_COUNT];
+
+#define JP_TAKEN_CYCLES 4
+#define JR_TAKEN_CYCLES 4
+#define CALL_TAKEN_CYCLES 12
+#define RET_TAKEN_CYCLES 12
+#define HALT_CYCLES 4
+
 Instruction inst_from_byte(uint8_t byte);
 Instruction pf_inst_from_byte(uint8_t byte);
 
@@ -191,7 +225,14 @@ Instruction new_pop(enum Operand target);
 /* Call and Return Instructions */
 Instruction new_call(enum JumpCondition jump_cond);
 Instruction new_ret(enum JumpCondition jump_cond);
-// Instruction new_reti(enum JumpCondition jump_cond);
+Instruction new_reti(void);
+Instruction new_rst(uint8_t vector);
+
+/* Interrupt and CPU Control Instructions */
+Instruction new_di(void);
+Instruction new_ei(void);
+Instruction new_halt(void);
+Instruction new_stop(void);
 
 /* No Op Instruction */
 Instruction new_nop(void);
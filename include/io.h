@@ -0,0 +1,68 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+/* I/O registers
+ *
+ * The page at IO_START (I/O registers, HRAM and IE) goes through io_read()
+ * and io_write(). Registers that are modelled are dispatched to their
+ * component, everything else is plain memory in Memory.high.
+ *
+ * The timer (timer.c) doesn't tick. DIV is worked out from cpu->cycles
+ * when it is read, TIMA from the number of falling edges of the selected
+ * bit of the internal counter since it was last written, and the next
+ * TIMA overflow is the only timer event that gets scheduled.
+ *
+ * Interrupts (interrupts.c) are taken by run_until() and step() between
+ * instructions, or between blocks with DISPATCH=blocks. Whatever makes one
+ * takeable (requesting it, writing IE, EI, RETI) stops the running CPU
+ * through its limit, so the dispatch loops don't check IE and IF at all.
+ * Only an event can wake up a halted CPU, so HALT and STOP skip straight
+ * to the next one (or the end of the run) instead of idling through it.
+ *
+ * This header is included by cpu.h.
+ */
+
+#define IO_DIV 0xFF04
+#define IO_TIMA 0xFF05
+#define IO_TMA 0xFF06
+#define IO_TAC 0xFF07
+#define IO_IF 0xFF0F
+#define IO_IE 0xFFFF
+
+/* Interrupt bits of IF and IE */
+#define INT_VBLANK 0x01
+#define INT_STAT 0x02
+#define INT_TIMER 0x04
+#define INT_SERIAL 0x08
+#define INT_JOYPAD 0x10
+#define INT_M 0x1F
+#define IF_UNUSED_M 0xE0 /*Upper bits of IF read as 1*/
+
+#define INT_VECTORS 0x0040 /*Handler of interrupt bit n is at INT_VECTORS + n * INT_VECTOR_SIZE*/
+#define INT_VECTOR_SIZE 8
+#define INT_DISPATCH_CYCLES 20
+
+#define TAC_ENABLE 0x04
+#define TAC_CLOCK_M 0x03
+
+typedef struct CPU CPU;
+
+typedef struct {
+    uint64_t div_base;  /*cpu->cycles when the internal counter was last reset*/
+    uint64_t tima_time; /*cpu->cycles TIMA was last brought up to date at*/
+    uint8_t tima;
+    uint8_t tma;
+    uint8_t tac;
+} Timer;
+
+uint8_t io_read(CPU *cpu, uint16_t addr);
+void io_write(CPU *cpu, uint16_t addr, uint8_t val);
+
+void request_interrupt(CPU *cpu, uint8_t interrupt);
+void update_interrupts(CPU *cpu);
+bool handle_interrupts(CPU *cpu);
+void finish_ei(CPU *cpu);
+
+void sync_timer(CPU *cpu);
+uint8_t read_timer(CPU *cpu, uint16_t addr);
+void write_timer(CPU *cpu, uint16_t addr, uint8_t val);
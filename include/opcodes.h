@@ -0,0 +1,589 @@
+/* Opcode map of the SM83
+ *
+ * Every entry describes one opcode as
+ *
+ * X(opcode, kind, bit_index, jump_cond, target, source)
+ *
+ * which mirrors the field order of Instruction. The lists are expanded
+ * wherever something has to be generated per opcode, e.g. the decode tables.
+ *
+ * ALU_OPCODES holds the arithmetic and logic opcodes, which also get
+ * flag-free handlers (see handlers.h). BASE_OPCODES includes them.
+ *
+ * Source: https://www.pastraiser.com/cpu/gameboy/gameboy_opcodes.html
+ */
+
+// NOLINTBEGIN
+#define ALU_OPCODES(X)                    \
+    /* ADD */                             \
+    X(0x87, ADD, 0, 0, O_A, O_A)          \
+    X(0x80, ADD, 0, 0, O_A, O_B)          \
+    X(0x81, ADD, 0, 0, O_A, O_C)          \
+    X(0x82, ADD, 0, 0, O_A, O_D)          \
+    X(0x83, ADD, 0, 0, O_A, O_E)          \
+    X(0x84, ADD, 0, 0, O_A, O_H)          \
+    X(0x85, ADD, 0, 0, O_A, O_L)          \
+    /* ADD_HL */                          \
+    X(0x09, ADD_HL, 0, 0, O_A, O_BC)      \
+    X(0x19, ADD_HL, 0, 0, O_A, O_DE)      \
+    X(0x29, ADD_HL, 0, 0, O_A, O_HL)      \
+    X(0x39, ADD_HL, 0, 0, O_A, O_SP)      \
+    /* ADD_IND */                         \
+    X(0x86, ADD_IND, 0, 0, O_A, O_HL_IND) \
+    /* ADD_D8 */                          \
+    X(0xC6, ADD_D8, 0, 0, O_A, O_D8)      \
+    /* ADC */                             \
+    X(0x8F, ADC, 0, 0, O_A, O_A)          \
+    X(0x88, ADC, 0, 0, O_A, O_B)          \
+    X(0x89, ADC, 0, 0, O_A, O_C)          \
+    X(0x8A, ADC, 0, 0, O_A, O_D)          \
+    X(0x8B, ADC, 0, 0, O_A, O_E)          \
+    X(0x8C, ADC, 0, 0, O_A, O_H)          \
+    X(0x8D, ADC, 0, 0, O_A, O_L)          \
+    /* ADC_IND */                         \
+    X(0x8E, ADC_IND, 0, 0, O_A, O_HL_IND) \
+    /* ADC_D8 */                          \
+    X(0xCE, ADC_D8, 0, 0, O_A, O_D8)      \
+    /* SUB */                             \
+    X(0x97, SUB, 0, 0, O_A, O_A)          \
+    X(0x90, SUB, 0, 0, O_A, O_B)          \
+    X(0x91, SUB, 0, 0, O_A, O_C)          \
+    X(0x92, SUB, 0, 0, O_A, O_D)          \
+    X(0x93, SUB, 0, 0, O_A, O_E)          \
+    X(0x94, SUB, 0, 0, O_A, O_H)          \
+    X(0x95, SUB, 0, 0, O_A, O_L)          \
+    /* SUB_IND */                         \
+    X(0x96, SUB_IND, 0, 0, O_A, O_HL_IND) \
+    /* SUB_D8 */                          \
+    X(0xD6, SUB_D8, 0, 0, O_A, O_D8)      \
+    /* SBC */                             \
+    X(0x9F, SBC, 0, 0, O_A, O_A)          \
+    X(0x98, SBC, 0, 0, O_A, O_B)          \
+    X(0x99, SBC, 0, 0, O_A, O_C)          \
+    X(0x9A, SBC, 0, 0, O_A, O_D)          \
+    X(0x9B, SBC, 0, 0, O_A, O_E)          \
+    X(0x9C, SBC, 0, 0, O_A, O_H)          \
+    X(0x9D, SBC, 0, 0, O_A, O_L)          \
+    /* SBC_IND */                         \
+    X(0x9E, SBC_IND, 0, 0, O_A, O_HL_IND) \
+    /* SBC_D8 */                          \
+    X(0xDE, SBC_D8, 0, 0, O_A, O_D8)      \
+    /* AND */                             \
+    X(0xA7, AND, 0, 0, O_A, O_A)          \
+    X(0xA0, AND, 0, 0, O_A, O_B)          \
+    X(0xA1, AND, 0, 0, O_A, O_C)          \
+    X(0xA2, AND, 0, 0, O_A, O_D)          \
+    X(0xA3, AND, 0, 0, O_A, O_E)          \
+    X(0xA4, AND, 0, 0, O_A, O_H)          \
+    X(0xA5, AND, 0, 0, O_A, O_L)          \
+    /* AND_IND */                         \
+    X(0xA6, AND_IND, 0, 0, O_A, O_HL_IND) \
+    /* AND_D8 */                          \
+    X(0xE6, AND_D8, 0, 0, O_A, O_D8)      \
+    /* OR */                              \
+    X(0xB7, OR, 0, 0, O_A, O_A)           \
+    X(0xB0, OR, 0, 0, O_A, O_B)           \
+    X(0xB1, OR, 0, 0, O_A, O_C)           \
+    X(0xB2, OR, 0, 0, O_A, O_D)           \
+    X(0xB3, OR, 0, 0, O_A, O_E)           \
+    X(0xB4, OR, 0, 0, O_A, O_H)           \
+    X(0xB5, OR, 0, 0, O_A, O_L)           \
+    /* OR_IND */                          \
+    X(0xB6, OR_IND, 0, 0, O_A, O_HL_IND)  \
+    /* OR_D8 */                           \
+    X(0xF6, OR_D8, 0, 0, O_A, O_D8)       \
+    /* XOR */                             \
+    X(0xAF, XOR, 0, 0, O_A, O_A)          \
+    X(0xA8, XOR, 0, 0, O_A, O_B)          \
+    X(0xA9, XOR, 0, 0, O_A, O_C)          \
+    X(0xAA, XOR, 0, 0, O_A, O_D)          \
+    X(0xAB, XOR, 0, 0, O_A, O_E)          \
+    X(0xAC, XOR, 0, 0, O_A, O_H)          \
+    X(0xAD, XOR, 0, 0, O_A, O_L)          \
+    /* XOR_IND */                         \
+    X(0xAE, XOR_IND, 0, 0, O_A, O_HL_IND) \
+    /* XOR_D8 */                          \
+    X(0xEE, XOR_D8, 0, 0, O_A, O_D8)      \
+    /* CP */                              \
+    X(0xBF, CP, 0, 0, O_A, O_A)           \
+    X(0xB8, CP, 0, 0, O_A, O_B)           \
+    X(0xB9, CP, 0, 0, O_A, O_C)           \
+    X(0xBA, CP, 0, 0, O_A, O_D)           \
+    X(0xBB, CP, 0, 0, O_A, O_E)           \
+    X(0xBC, CP, 0, 0, O_A, O_H)           \
+    X(0xBD, CP, 0, 0, O_A, O_L)           \
+    /* CP_IND */                          \
+    X(0xBE, CP_IND, 0, 0, O_A, O_HL_IND)  \
+    /* CP_D8 */                           \
+    X(0xFE, CP_D8, 0, 0, O_A, O_D8)       \
+    /* INC */                             \
+    X(0x3C, INC, 0, 0, O_A, O_A)          \
+    X(0x04, INC, 0, 0, O_A, O_B)          \
+    X(0x0C, INC, 0, 0, O_A, O_C)          \
+    X(0x14, INC, 0, 0, O_A, O_D)          \
+    X(0x1C, INC, 0, 0, O_A, O_E)          \
+    X(0x24, INC, 0, 0, O_A, O_H)          \
+    X(0x2C, INC, 0, 0, O_A, O_L)          \
+    X(0x03, INC, 0, 0, O_A, O_BC)         \
+    X(0x13, INC, 0, 0, O_A, O_DE)         \
+    X(0x23, INC, 0, 0, O_A, O_HL)         \
+    X(0x33, INC, 0, 0, O_A, O_SP)         \
+    /* INC_IND */                         \
+    X(0x34, INC_IND, 0, 0, O_A, O_HL_IND) \
+    /* DEC */                             \
+    X(0x3D, DEC, 0, 0, O_A, O_A)          \
+    X(0x05, DEC, 0, 0, O_A, O_B)          \
+    X(0x0D, DEC, 0, 0, O_A, O_C)          \
+    X(0x15, DEC, 0, 0, O_A, O_D)          \
+    X(0x1D, DEC, 0, 0, O_A, O_E)          \
+    X(0x25, DEC, 0, 0, O_A, O_H)          \
+    X(0x2D, DEC, 0, 0, O_A, O_L)          \
+    X(0x0B, DEC, 0, 0, O_A, O_BC)         \
+    X(0x1B, DEC, 0, 0, O_A, O_DE)         \
+    X(0x2B, DEC, 0, 0, O_A, O_HL)         \
+    X(0x3B, DEC, 0, 0, O_A, O_SP)         \
+    /* DEC_IND */                         \
+    X(0x35, DEC_IND, 0, 0, O_A, O_HL_IND)
+
+#define BASE_OPCODES(X)                      \
+    ALU_OPCODES(X)                           \
+    /* CCF */                                \
+    X(0x3F, CCF, 0, 0, O_A, 0)               \
+    /* SCF */                                \
+    X(0x37, SCF, 0, 0, O_A, 0)               \
+    /* RRA */                                \
+    X(0x1F, RRA, 0, 0, O_A, 0)               \
+    /* RLA */                                \
+    X(0x17, RLA, 0, 0, O_A, 0)               \
+    /* RRCA */                               \
+    X(0x0F, RRCA, 0, 0, O_A, 0)              \
+    /* RLCA */                               \
+    X(0x07, RLCA, 0, 0, O_A, 0)              \
+    /* CPL */                                \
+    X(0x2F, CPL, 0, 0, O_A, 0)               \
+    /* JP */                                 \
+    X(0xC2, JP, 0, NOT_ZERO, 0, 0)           \
+    X(0xD2, JP, 0, NOT_CARRY, 0, 0)          \
+    X(0xC3, JP, 0, ALWAYS, 0, 0)             \
+    X(0xCA, JP, 0, ZERO, 0, 0)               \
+    X(0xDA, JP, 0, CARRY, 0, 0)              \
+    /* JPHL */                               \
+    X(0xE9, JP_HL, 0, ALWAYS, 0, 0)          \
+    /* JR */                                 \
+    X(0x20, JR, 0, NOT_ZERO, 0, 0)           \
+    X(0x30, JR, 0, NOT_CARRY, 0, 0)          \
+    X(0x18, JR, 0, ALWAYS, 0, 0)             \
+    X(0x28, JR, 0, ZERO, 0, 0)               \
+    X(0x38, JR, 0, CARRY, 0, 0)              \
+    /* LD_REG */                             \
+    X(0x47, LD_REG, 0, 0, O_B, O_A)          \
+    X(0x40, LD_REG, 0, 0, O_B, O_B)          \
+    X(0x41, LD_REG, 0, 0, O_B, O_C)          \
+    X(0x42, LD_REG, 0, 0, O_B, O_D)          \
+    X(0x43, LD_REG, 0, 0, O_B, O_E)          \
+    X(0x44, LD_REG, 0, 0, O_B, O_H)          \
+    X(0x45, LD_REG, 0, 0, O_B, O_L)          \
+    X(0x4F, LD_REG, 0, 0, O_C, O_A)          \
+    X(0x48, LD_REG, 0, 0, O_C, O_B)          \
+    X(0x49, LD_REG, 0, 0, O_C, O_C)          \
+    X(0x4A, LD_REG, 0, 0, O_C, O_D)          \
+    X(0x4B, LD_REG, 0, 0, O_C, O_E)          \
+    X(0x4C, LD_REG, 0, 0, O_C, O_H)          \
+    X(0x4D, LD_REG, 0, 0, O_C, O_L)          \
+    X(0x57, LD_REG, 0, 0, O_D, O_A)          \
+    X(0x50, LD_REG, 0, 0, O_D, O_B)          \
+    X(0x51, LD_REG, 0, 0, O_D, O_C)          \
+    X(0x52, LD_REG, 0, 0, O_D, O_D)          \
+    X(0x53, LD_REG, 0, 0, O_D, O_E)          \
+    X(0x54, LD_REG, 0, 0, O_D, O_H)          \
+    X(0x55, LD_REG, 0, 0, O_D, O_L)          \
+    X(0x5F, LD_REG, 0, 0, O_E, O_A)          \
+    X(0x58, LD_REG, 0, 0, O_E, O_B)          \
+    X(0x59, LD_REG, 0, 0, O_E, O_C)          \
+    X(0x5A, LD_REG, 0, 0, O_E, O_D)          \
+    X(0x5B, LD_REG, 0, 0, O_E, O_E)          \
+    X(0x5C, LD_REG, 0, 0, O_E, O_H)          \
+    X(0x5D, LD_REG, 0, 0, O_E, O_L)          \
+    X(0x67, LD_REG, 0, 0, O_H, O_A)          \
+    X(0x60, LD_REG, 0, 0, O_H, O_B)          \
+    X(0x61, LD_REG, 0, 0, O_H, O_C)          \
+    X(0x62, LD_REG, 0, 0, O_H, O_D)          \
+    X(0x63, LD_REG, 0, 0, O_H, O_E)          \
+    X(0x64, LD_REG, 0, 0, O_H, O_H)          \
+    X(0x65, LD_REG, 0, 0, O_H, O_L)          \
+    X(0x6F, LD_REG, 0, 0, O_L, O_A)          \
+    X(0x68, LD_REG, 0, 0, O_L, O_B)          \
+    X(0x69, LD_REG, 0, 0, O_L, O_C)          \
+    X(0x6A, LD_REG, 0, 0, O_L, O_D)          \
+    X(0x6B, LD_REG, 0, 0, O_L, O_E)          \
+    X(0x6C, LD_REG, 0, 0, O_L, O_H)          \
+    X(0x6D, LD_REG, 0, 0, O_L, O_L)          \
+    X(0x7F, LD_REG, 0, 0, O_A, O_A)          \
+    X(0x78, LD_REG, 0, 0, O_A, O_B)          \
+    X(0x79, LD_REG, 0, 0, O_A, O_C)          \
+    X(0x7A, LD_REG, 0, 0, O_A, O_D)          \
+    X(0x7B, LD_REG, 0, 0, O_A, O_E)          \
+    X(0x7C, LD_REG, 0, 0, O_A, O_H)          \
+    X(0x7D, LD_REG, 0, 0, O_A, O_L)          \
+    /* LD_D8 */                              \
+    X(0x3E, LD_D8, 0, 0, O_A, O_D8)          \
+    X(0x06, LD_D8, 0, 0, O_B, O_D8)          \
+    X(0x0E, LD_D8, 0, 0, O_C, O_D8)          \
+    X(0x16, LD_D8, 0, 0, O_D, O_D8)          \
+    X(0x1E, LD_D8, 0, 0, O_E, O_D8)          \
+    X(0x26, LD_D8, 0, 0, O_H, O_D8)          \
+    X(0x2E, LD_D8, 0, 0, O_L, O_D8)          \
+    /* LD_D16 */                             \
+    X(0x01, LD_D16, 0, 0, O_BC, O_D16)       \
+    X(0x11, LD_D16, 0, 0, O_DE, O_D16)       \
+    X(0x21, LD_D16, 0, 0, O_HL, O_D16)       \
+    X(0x31, LD_D16, 0, 0, O_SP, O_D16)       \
+    /* LD_D8_IND */                          \
+    X(0x36, LD_D8_IND, 0, 0, O_HL_IND, O_D8) \
+    /* LD_IND */                             \
+    X(0x02, LD_IND, 0, 0, O_BC_IND, O_A)     \
+    X(0x12, LD_IND, 0, 0, O_DE_IND, O_A)     \
+    X(0x0A, LD_IND, 0, 0, O_A, O_BC_IND)     \
+    X(0x1A, LD_IND, 0, 0, O_A, O_DE_IND)     \
+    X(0x7E, LD_IND, 0, 0, O_A, O_HL_IND)     \
+    X(0x46, LD_IND, 0, 0, O_B, O_HL_IND)     \
+    X(0x4E, LD_IND, 0, 0, O_C, O_HL_IND)     \
+    X(0x56, LD_IND, 0, 0, O_D, O_HL_IND)     \
+    X(0x5E, LD_IND, 0, 0, O_E, O_HL_IND)     \
+    X(0x66, LD_IND, 0, 0, O_H, O_HL_IND)     \
+    X(0x6E, LD_IND, 0, 0, O_L, O_HL_IND)     \
+    X(0x77, LD_IND, 0, 0, O_HL_IND, O_A)     \
+    X(0x70, LD_IND, 0, 0, O_HL_IND, O_B)     \
+    X(0x71, LD_IND, 0, 0, O_HL_IND, O_C)     \
+    X(0x72, LD_IND, 0, 0, O_HL_IND, O_D)     \
+    X(0x73, LD_IND, 0, 0, O_HL_IND, O_E)     \
+    X(0x74, LD_IND, 0, 0, O_HL_IND, O_H)     \
+    X(0x75, LD_IND, 0, 0, O_HL_IND, O_L)     \
+    /* LD_ADDR */                            \
+    X(0xEA, LD_ADDR, 0, 0, O_A16_IND, O_A)   \
+    X(0xFA, LD_ADDR, 0, 0, O_A, O_A16_IND)   \
+    /* LD_INC */                             \
+    X(0x22, LD_INC, 0, 0, O_HL_INC_IND, O_A) \
+    X(0x2A, LD_INC, 0, 0, O_A, O_HL_INC_IND) \
+    /* LD_DEC */                             \
+    X(0x32, LD_DEC, 0, 0, O_HL_DEC_IND, O_A) \
+    X(0x3A, LD_DEC, 0, 0, O_A, O_HL_DEC_IND) \
+    /* LDH_IND */                            \
+    X(0xE2, LDH_IND, 0, 0, O_C_IND, O_A)     \
+    X(0xF2, LDH_IND, 0, 0, O_A, O_C_IND)     \
+    /* LDH_ADDR */                           \
+    X(0xE0, LDH_ADDR, 0, 0, O_A8_IND, O_A)   \
+    X(0xF0, LDH_ADDR, 0, 0, O_A, O_A8_IND)   \
+    /* PUSH */                               \
+    X(0xF5, PUSH, 0, 0, 0, O_AF)             \
+    X(0xC5, PUSH, 0, 0, 0, O_BC)             \
+    X(0xD5, PUSH, 0, 0, 0, O_DE)             \
+    X(0xE5, PUSH, 0, 0, 0, O_HL)             \
+    /* POP */                                \
+    X(0xF1, POP, 0, 0, O_AF, 0)              \
+    X(0xC1, POP, 0, 0, O_BC, 0)              \
+    X(0xD1, POP, 0, 0, O_DE, 0)              \
+    X(0xE1, POP, 0, 0, O_HL, 0)              \
+    /* CALL */                               \
+    X(0xC4, CALL, 0, NOT_ZERO, 0, 0)         \
+    X(0xD4, CALL, 0, NOT_CARRY, 0, 0)        \
+    X(0xCC, CALL, 0, ZERO, 0, 0)             \
+    X(0xDC, CALL, 0, CARRY, 0, 0)            \
+    X(0xCD, CALL, 0, ALWAYS, 0, 0)           \
+    /* RET */                                \
+    X(0xC0, RET, 0, NOT_ZERO, 0, 0)          \
+    X(0xD0, RET, 0, NOT_CARRY, 0, 0)         \
+    X(0xC8, RET, 0, ZERO, 0, 0)              \
+    X(0xD8, RET, 0, CARRY, 0, 0)             \
+    X(0xC9, RET, 0, ALWAYS, 0, 0)            \
+    /* RETI */                               \
+    X(0xD9, RETI, 0, ALWAYS, 0, 0)           \
+    /* RST */                                \
+    X(0xC7, RST, 0x00, ALWAYS, 0, 0)         \
+    X(0xCF, RST, 0x08, ALWAYS, 0, 0)         \
+    X(0xD7, RST, 0x10, ALWAYS, 0, 0)         \
+    X(0xDF, RST, 0x18, ALWAYS, 0, 0)         \
+    X(0xE7, RST, 0x20, ALWAYS, 0, 0)         \
+    X(0xEF, RST, 0x28, ALWAYS, 0, 0)         \
+    X(0xF7, RST, 0x30, ALWAYS, 0, 0)         \
+    X(0xFF, RST, 0x38, ALWAYS, 0, 0)         \
+    /* DI */                                 \
+    X(0xF3, DI, 0, 0, 0, 0)                  \
+    /* EI */                                 \
+    X(0xFB, EI, 0, 0, 0, 0)                  \
+    /* HALT */                               \
+    X(0x76, HALT, 0, 0, 0, 0)                \
+    /* STOP */                               \
+    X(0x10, STOP, 0, 0, 0, 0)                \
+    /* NOP */                                \
+    X(0x00, NOP, 0, 0, 0, 0)
+
+#define PREFIX_OPCODES(X)         \
+    /* BIT */                     \
+    X(0x40, BIT, 0, 0, O_B, 0)    \
+    X(0x41, BIT, 0, 0, O_C, 0)    \
+    X(0x42, BIT, 0, 0, O_D, 0)    \
+    X(0x43, BIT, 0, 0, O_E, 0)    \
+    X(0x44, BIT, 0, 0, O_H, 0)    \
+    X(0x45, BIT, 0, 0, O_L, 0)    \
+    X(0x46, BIT, 0, 0, O_HL, 0)   \
+    X(0x47, BIT, 0, 0, O_A, 0)    \
+    X(0x48, BIT, 1, 0, O_B, 0)    \
+    X(0x49, BIT, 1, 0, O_C, 0)    \
+    X(0x4A, BIT, 1, 0, O_D, 0)    \
+    X(0x4B, BIT, 1, 0, O_E, 0)    \
+    X(0x4C, BIT, 1, 0, O_H, 0)    \
+    X(0x4D, BIT, 1, 0, O_L, 0)    \
+    X(0x4E, BIT, 1, 0, O_HL, 0)   \
+    X(0x4F, BIT, 1, 0, O_A, 0)    \
+    X(0x50, BIT, 2, 0, O_B, 0)    \
+    X(0x51, BIT, 2, 0, O_C, 0)    \
+    X(0x52, BIT, 2, 0, O_D, 0)    \
+    X(0x53, BIT, 2, 0, O_E, 0)    \
+    X(0x54, BIT, 2, 0, O_H, 0)    \
+    X(0x55, BIT, 2, 0, O_L, 0)    \
+    X(0x56, BIT, 2, 0, O_HL, 0)   \
+    X(0x57, BIT, 2, 0, O_A, 0)    \
+    X(0x58, BIT, 3, 0, O_B, 0)    \
+    X(0x59, BIT, 3, 0, O_C, 0)    \
+    X(0x5A, BIT, 3, 0, O_D, 0)    \
+    X(0x5B, BIT, 3, 0, O_E, 0)    \
+    X(0x5C, BIT, 3, 0, O_H, 0)    \
+    X(0x5D, BIT, 3, 0, O_L, 0)    \
+    X(0x5E, BIT, 3, 0, O_HL, 0)   \
+    X(0x5F, BIT, 3, 0, O_A, 0)    \
+    X(0x60, BIT, 4, 0, O_B, 0)    \
+    X(0x61, BIT, 4, 0, O_C, 0)    \
+    X(0x62, BIT, 4, 0, O_D, 0)    \
+    X(0x63, BIT, 4, 0, O_E, 0)    \
+    X(0x64, BIT, 4, 0, O_H, 0)    \
+    X(0x65, BIT, 4, 0, O_L, 0)    \
+    X(0x66, BIT, 4, 0, O_HL, 0)   \
+    X(0x67, BIT, 4, 0, O_A, 0)    \
+    X(0x68, BIT, 5, 0, O_B, 0)    \
+    X(0x69, BIT, 5, 0, O_C, 0)    \
+    X(0x6A, BIT, 5, 0, O_D, 0)    \
+    X(0x6B, BIT, 5, 0, O_E, 0)    \
+    X(0x6C, BIT, 5, 0, O_H, 0)    \
+    X(0x6D, BIT, 5, 0, O_L, 0)    \
+    X(0x6E, BIT, 5, 0, O_HL, 0)   \
+    X(0x6F, BIT, 5, 0, O_A, 0)    \
+    X(0x70, BIT, 6, 0, O_B, 0)    \
+    X(0x71, BIT, 6, 0, O_C, 0)    \
+    X(0x72, BIT, 6, 0, O_D, 0)    \
+    X(0x73, BIT, 6, 0, O_E, 0)    \
+    X(0x74, BIT, 6, 0, O_H, 0)    \
+    X(0x75, BIT, 6, 0, O_L, 0)    \
+    X(0x76, BIT, 6, 0, O_HL, 0)   \
+    X(0x77, BIT, 6, 0, O_A, 0)    \
+    X(0x78, BIT, 7, 0, O_B, 0)    \
+    X(0x79, BIT, 7, 0, O_C, 0)    \
+    X(0x7A, BIT, 7, 0, O_D, 0)    \
+    X(0x7B, BIT, 7, 0, O_E, 0)    \
+    X(0x7C, BIT, 7, 0, O_H, 0)    \
+    X(0x7D, BIT, 7, 0, O_L, 0)    \
+    X(0x7E, BIT, 7, 0, O_HL, 0)   \
+    X(0x7F, BIT, 7, 0, O_A, 0)    \
+    /* RESET */                   \
+    X(0x80, RESET, 0, 0, O_B, 0)  \
+    X(0x81, RESET, 0, 0, O_C, 0)  \
+    X(0x82, RESET, 0, 0, O_D, 0)  \
+    X(0x83, RESET, 0, 0, O_E, 0)  \
+    X(0x84, RESET, 0, 0, O_H, 0)  \
+    X(0x85, RESET, 0, 0, O_L, 0)  \
+    X(0x86, RESET, 0, 0, O_HL, 0) \
+    X(0x87, RESET, 0, 0, O_A, 0)  \
+    X(0x88, RESET, 1, 0, O_B, 0)  \
+    X(0x89, RESET, 1, 0, O_C, 0)  \
+    X(0x8A, RESET, 1, 0, O_D, 0)  \
+    X(0x8B, RESET, 1, 0, O_E, 0)  \
+    X(0x8C, RESET, 1, 0, O_H, 0)  \
+    X(0x8D, RESET, 1, 0, O_L, 0)  \
+    X(0x8E, RESET, 1, 0, O_HL, 0) \
+    X(0x8F, RESET, 1, 0, O_A, 0)  \
+    X(0x90, RESET, 2, 0, O_B, 0)  \
+    X(0x91, RESET, 2, 0, O_C, 0)  \
+    X(0x92, RESET, 2, 0, O_D, 0)  \
+    X(0x93, RESET, 2, 0, O_E, 0)  \
+    X(0x94, RESET, 2, 0, O_H, 0)  \
+    X(0x95, RESET, 2, 0, O_L, 0)  \
+    X(0x96, RESET, 2, 0, O_HL, 0) \
+    X(0x97, RESET, 2, 0, O_A, 0)  \
+    X(0x98, RESET, 3, 0, O_B, 0)  \
+    X(0x99, RESET, 3, 0, O_C, 0)  \
+    X(0x9A, RESET, 3, 0, O_D, 0)  \
+    X(0x9B, RESET, 3, 0, O_E, 0)  \
+    X(0x9C, RESET, 3, 0, O_H, 0)  \
+    X(0x9D, RESET, 3, 0, O_L, 0)  \
+    X(0x9E, RESET, 3, 0, O_HL, 0) \
+    X(0x9F, RESET, 3, 0, O_A, 0)  \
+    X(0xA0, RESET, 4, 0, O_B, 0)  \
+    X(0xA1, RESET, 4, 0, O_C, 0)  \
+    X(0xA2, RESET, 4, 0, O_D, 0)  \
+    X(0xA3, RESET, 4, 0, O_E, 0)  \
+    X(0xA4, RESET, 4, 0, O_H, 0)  \
+    X(0xA5, RESET, 4, 0, O_L, 0)  \
+    X(0xA6, RESET, 4, 0, O_HL, 0) \
+    X(0xA7, RESET, 4, 0, O_A, 0)  \
+    X(0xA8, RESET, 5, 0, O_B, 0)  \
+    X(0xA9, RESET, 5, 0, O_C, 0)  \
+    X(0xAA, RESET, 5, 0, O_D, 0)  \
+    X(0xAB, RESET, 5, 0, O_E, 0)  \
+    X(0xAC, RESET, 5, 0, O_H, 0)  \
+    X(0xAD, RESET, 5, 0, O_L, 0)  \
+    X(0xAE, RESET, 5, 0, O_HL, 0) \
+    X(0xAF, RESET, 5, 0, O_A, 0)  \
+    X(0xB0, RESET, 6, 0, O_B, 0)  \
+    X(0xB1, RESET, 6, 0, O_C, 0)  \
+    X(0xB2, RESET, 6, 0, O_D, 0)  \
+    X(0xB3, RESET, 6, 0, O_E, 0)  \
+    X(0xB4, RESET, 6, 0, O_H, 0)  \
+    X(0xB5, RESET, 6, 0, O_L, 0)  \
+    X(0xB6, RESET, 6, 0, O_HL, 0) \
+    X(0xB7, RESET, 6, 0, O_A, 0)  \
+    X(0xB8, RESET, 7, 0, O_B, 0)  \
+    X(0xB9, RESET, 7, 0, O_C, 0)  \
+    X(0xBA, RESET, 7, 0, O_D, 0)  \
+    X(0xBB, RESET, 7, 0, O_E, 0)  \
+    X(0xBC, RESET, 7, 0, O_H, 0)  \
+    X(0xBD, RESET, 7, 0, O_L, 0)  \
+    X(0xBE, RESET, 7, 0, O_HL, 0) \
+    X(0xBF, RESET, 7, 0, O_A, 0)  \
+    /* SET */                     \
+    X(0xC0, SET, 0, 0, O_B, 0)    \
+    X(0xC1, SET, 0, 0, O_C, 0)    \
+    X(0xC2, SET, 0, 0, O_D, 0)    \
+    X(0xC3, SET, 0, 0, O_E, 0)    \
+    X(0xC4, SET, 0, 0, O_H, 0)    \
+    X(0xC5, SET, 0, 0, O_L, 0)    \
+    X(0xC6, SET, 0, 0, O_HL, 0)   \
+    X(0xC7, SET, 0, 0, O_A, 0)    \
+    X(0xC8, SET, 1, 0, O_B, 0)    \
+    X(0xC9, SET, 1, 0, O_C, 0)    \
+    X(0xCA, SET, 1, 0, O_D, 0)    \
+    X(0xCB, SET, 1, 0, O_E, 0)    \
+    X(0xCC, SET, 1, 0, O_H, 0)    \
+    X(0xCD, SET, 1, 0, O_L, 0)    \
+    X(0xCE, SET, 1, 0, O_HL, 0)   \
+    X(0xCF, SET, 1, 0, O_A, 0)    \
+    X(0xD0, SET, 2, 0, O_B, 0)    \
+    X(0xD1, SET, 2, 0, O_C, 0)    \
+    X(0xD2, SET, 2, 0, O_D, 0)    \
+    X(0xD3, SET, 2, 0, O_E, 0)    \
+    X(0xD4, SET, 2, 0, O_H, 0)    \
+    X(0xD5, SET, 2, 0, O_L, 0)    \
+    X(0xD6, SET, 2, 0, O_HL, 0)   \
+    X(0xD7, SET, 2, 0, O_A, 0)    \
+    X(0xD8, SET, 3, 0, O_B, 0)    \
+    X(0xD9, SET, 3, 0, O_C, 0)    \
+    X(0xDA, SET, 3, 0, O_D, 0)    \
+    X(0xDB, SET, 3, 0, O_E, 0)    \
+    X(0xDC, SET, 3, 0, O_H, 0)    \
+    X(0xDD, SET, 3, 0, O_L, 0)    \
+    X(0xDE, SET, 3, 0, O_HL, 0)   \
+    X(0xDF, SET, 3, 0, O_A, 0)    \
+    X(0xE0, SET, 4, 0, O_B, 0)    \
+    X(0xE1, SET, 4, 0, O_C, 0)    \
+    X(0xE2, SET, 4, 0, O_D, 0)    \
+    X(0xE3, SET, 4, 0, O_E, 0)    \
+    X(0xE4, SET, 4, 0, O_H, 0)    \
+    X(0xE5, SET, 4, 0, O_L, 0)    \
+    X(0xE6, SET, 4, 0, O_HL, 0)   \
+    X(0xE7, SET, 4, 0, O_A, 0)    \
+    X(0xE8, SET, 5, 0, O_B, 0)    \
+    X(0xE9, SET, 5, 0, O_C, 0)    \
+    X(0xEA, SET, 5, 0, O_D, 0)    \
+    X(0xEB, SET, 5, 0, O_E, 0)    \
+    X(0xEC, SET, 5, 0, O_H, 0)    \
+    X(0xED, SET, 5, 0, O_L, 0)    \
+    X(0xEE, SET, 5, 0, O_HL, 0)   \
+    X(0xEF, SET, 5, 0, O_A, 0)    \
+    X(0xF0, SET, 6, 0, O_B, 0)    \
+    X(0xF1, SET, 6, 0, O_C, 0)    \
+    X(0xF2, SET, 6, 0, O_D, 0)    \
+    X(0xF3, SET, 6, 0, O_E, 0)    \
+    X(0xF4, SET, 6, 0, O_H, 0)    \
+    X(0xF5, SET, 6, 0, O_L, 0)    \
+    X(0xF6, SET, 6, 0, O_HL, 0)   \
+    X(0xF7, SET, 6, 0, O_A, 0)    \
+    X(0xF8, SET, 7, 0, O_B, 0)    \
+    X(0xF9, SET, 7, 0, O_C, 0)    \
+    X(0xFA, SET, 7, 0, O_D, 0)    \
+    X(0xFB, SET, 7, 0, O_E, 0)    \
+    X(0xFC, SET, 7, 0, O_H, 0)    \
+    X(0xFD, SET, 7, 0, O_L, 0)    \
+    X(0xFE, SET, 7, 0, O_HL, 0)   \
+    X(0xFF, SET, 7, 0, O_A, 0)    \
+    /* SRL */                     \
+    X(0x38, SRL, 0, 0, O_B, 0)    \
+    X(0x39, SRL, 0, 0, O_C, 0)    \
+    X(0x3A, SRL, 0, 0, O_D, 0)    \
+    X(0x3B, SRL, 0, 0, O_E, 0)    \
+    X(0x3C, SRL, 0, 0, O_H, 0)    \
+    X(0x3D, SRL, 0, 0, O_L, 0)    \
+    X(0x3E, SRL, 0, 0, O_HL, 0)   \
+    X(0x3F, SRL, 0, 0, O_A, 0)    \
+    /* RR */                      \
+    X(0x18, RR, 0, 0, O_B, 0)     \
+    X(0x19, RR, 0, 0, O_C, 0)     \
+    X(0x1A, RR, 0, 0, O_D, 0)     \
+    X(0x1B, RR, 0, 0, O_E, 0)     \
+    X(0x1C, RR, 0, 0, O_H, 0)     \
+    X(0x1D, RR, 0, 0, O_L, 0)     \
+    X(0x1E, RR, 0, 0, O_HL, 0)    \
+    X(0x1F, RR, 0, 0, O_A, 0)     \
+    /* RL */                      \
+    X(0x10, RL, 0, 0, O_B, 0)     \
+    X(0x11, RL, 0, 0, O_C, 0)     \
+    X(0x12, RL, 0, 0, O_D, 0)     \
+    X(0x13, RL, 0, 0, O_E, 0)     \
+    X(0x14, RL, 0, 0, O_H, 0)     \
+    X(0x15, RL, 0, 0, O_L, 0)     \
+    X(0x16, RL, 0, 0, O_HL, 0)    \
+    X(0x17, RL, 0, 0, O_A, 0)     \
+    /* RRC */                     \
+    X(0x08, RRC, 0, 0, O_B, 0)    \
+    X(0x09, RRC, 0, 0, O_C, 0)    \
+    X(0x0A, RRC, 0, 0, O_D, 0)    \
+    X(0x0B, RRC, 0, 0, O_E, 0)    \
+    X(0x0C, RRC, 0, 0, O_H, 0)    \
+    X(0x0D, RRC, 0, 0, O_L, 0)    \
+    X(0x0E, RRC, 0, 0, O_HL, 0)   \
+    X(0x0F, RRC, 0, 0, O_A, 0)    \
+    /* RLC */                     \
+    X(0x00, RLC, 0, 0, O_B, 0)    \
+    X(0x01, RLC, 0, 0, O_C, 0)    \
+    X(0x02, RLC, 0, 0, O_D, 0)    \
+    X(0x03, RLC, 0, 0, O_E, 0)    \
+    X(0x04, RLC, 0, 0, O_H, 0)    \
+    X(0x05, RLC, 0, 0, O_L, 0)    \
+    X(0x06, RLC, 0, 0, O_HL, 0)   \
+    X(0x07, RLC, 0, 0, O_A, 0)    \
+    /* SRA */                     \
+    X(0x28, SRA, 0, 0, O_B, 0)    \
+    X(0x29, SRA, 0, 0, O_C, 0)    \
+    X(0x2A, SRA, 0, 0, O_D, 0)    \
+    X(0x2B, SRA, 0, 0, O_E, 0)    \
+    X(0x2C, SRA, 0, 0, O_H, 0)    \
+    X(0x2D, SRA, 0, 0, O_L, 0)    \
+    X(0x2E, SRA, 0, 0, O_HL, 0)   \
+    X(0x2F, SRA, 0, 0, O_A, 0)    \
+    /* SLA */                     \
+    X(0x20, SLA, 0, 0, O_B, 0)    \
+    X(0x21, SLA, 0, 0, O_C, 0)    \
+    X(0x22, SLA, 0, 0, O_D, 0)    \
+    X(0x23, SLA, 0, 0, O_E, 0)    \
+    X(0x24, SLA, 0, 0, O_H, 0)    \
+    X(0x25, SLA, 0, 0, O_L, 0)    \
+    X(0x26, SLA, 0, 0, O_HL, 0)   \
+    X(0x27, SLA, 0, 0, O_A, 0)    \
+    /* SWAP */                    \
+    X(0x30, SWAP, 0, 0, O_B, 0)   \
+    X(0x31, SWAP, 0, 0, O_C, 0)   \
+    X(0x32, SWAP, 0, 0, O_D, 0)   \
+    X(0x33, SWAP, 0, 0, O_E, 0)   \
+    X(0x34, SWAP, 0, 0, O_H, 0)   \
+    X(0x35, SWAP, 0, 0, O_L, 0)   \
+    X(0x36, SWAP, 0, 0, O_HL, 0)  \
+    X(0x37, SWAP, 0, 0, O_A, 0)
+// NOLINTEND
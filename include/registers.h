@@ -11,45 +11,54 @@ enum RegisterName { A, B, C, D, E, F, H, L, AF, BC, DE, HL, SP };  // NOLINT
 
 const char *reg_name(enum RegisterName reg);
 
+/* REG_PAIR lays out a 16-bit register pair that shares its storage with
+ * its upper and lower 8-bit halves, e.g. bc with b and c.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define REG_PAIR(pair, upper, lower) \
+    union {                          \
+        uint16_t pair;               \
+        struct {                     \
+            uint8_t upper;           \
+            uint8_t lower;           \
+        };                           \
+    }
+#else
+#define REG_PAIR(pair, upper, lower) \
+    union {                          \
+        uint16_t pair;               \
+        struct {                     \
+            uint8_t lower;           \
+            uint8_t upper;           \
+        };                           \
+    }
+#endif
+
+/* The flags live only in the upper nibble of f */
+#define ZERO_FLAG_M (1 << ZERO_BIT_POS)
+#define SUBTRACT_FLAG_M (1 << SUBTRACT_BIT_POS)
+#define HALF_CARRY_FLAG_M (1 << HALF_CARRY_BIT_POS)
+#define CARRY_FLAG_M (1 << CARRY_BIT_POS)
+
 typedef struct {
-    uint8_t a;
-    uint8_t b;
-    uint8_t c;
-    uint8_t d;
-    uint8_t e;
-    uint8_t f;
-    uint8_t h;
-    uint8_t l;
+    REG_PAIR(af, a, f);
+    REG_PAIR(bc, b, c);
+    REG_PAIR(de, d, e);
+    REG_PAIR(hl, h, l);
+    uint16_t sp;
+    uint16_t pc;
 } Registers;
 
 Registers new_regs(void);
 
-uint16_t get_af(const Registers *regs);
-void set_af(Registers *regs, uint16_t val);
-
-uint16_t get_bc(const Registers *regs);
-void set_bc(Registers *regs, uint16_t val);
-
-uint16_t get_de(const Registers *regs);
-void set_de(Registers *regs, uint16_t val);
-
-uint16_t get_hl(const Registers *regs);
-void set_hl(Registers *regs, uint16_t val);
-
-typedef struct {
-    bool zero;
-    bool subtract;
-    bool half_carry;
-    bool carry;
-} FlagRegister;
-
-FlagRegister new_flag_reg(void);
+static inline uint16_t get_af(const Registers *regs) { return regs->af; }
+static inline void set_af(Registers *regs, uint16_t val) { regs->af = val; }
 
-uint8_t flag_reg_to_byte(FlagRegister *flag_reg);
+static inline uint16_t get_bc(const Registers *regs) { return regs->bc; }
+static inline void set_bc(Registers *regs, uint16_t val) { regs->bc = val; }
 
-FlagRegister byte_to_flag_reg(uint8_t byte);
+static inline uint16_t get_de(const Registers *regs) { return regs->de; }
+static inline void set_de(Registers *regs, uint16_t val) { regs->de = val; }
 
-uint8_t get_zero(FlagRegister *flag_reg);
-uint8_t get_subtract(FlagRegister *flag_reg);
-uint8_t get_half_carry(FlagRegister *flag_reg);
-uint8_t get_carry(FlagRegister *flag_reg);
+static inline uint16_t get_hl(const Registers *regs) { return regs->hl; }
+static inline void set_hl(Registers *regs, uint16_t val) { regs->hl = val; }
@@ -0,0 +1,55 @@
+#include <stdint.h>
+
+/* Event scheduler
+ *
+ * Hardware that does something at a given time (timer, PPU, APU, serial
+ * port) doesn't get ticked after every instruction. It schedules an event
+ * for the cycle at which it next has to act instead. run_cycles() runs the
+ * CPU flat out until the earliest pending event or the end of its budget,
+ * whichever comes first, then runs the events that are due and carries on.
+ *
+ * Events are kept in a binary min-heap on their time with at most one
+ * pending event per kind, so scheduling and cancelling are O(log n) and
+ * finding the next one is O(1). Handlers get the time their event was
+ * due, which may be a few cycles before cpu->cycles, as instructions
+ * aren't interrupted to run them.
+ *
+ * Handlers must schedule follow-up events later than the time they got.
+ *
+ * This header is included by cpu.h.
+ */
+
+#define NO_EVENT UINT64_MAX
+
+enum EventKind {  // NOLINT
+    EVENT_TIMER,
+    EVENT_PPU,
+    EVENT_APU,
+    EVENT_SERIAL,
+    EVENT_COUNT,
+};
+
+typedef struct CPU CPU;
+
+typedef void (*EventHandler)(CPU *cpu, uint64_t time);
+
+typedef struct {
+    uint64_t time; /*Value of cpu->cycles the event is due at*/
+    uint8_t kind;  /*enum EventKind*/
+} Event;
+
+typedef struct {
+    Event heap[EVENT_COUNT];
+    uint8_t size;
+    uint8_t slots[EVENT_COUNT]; /*Heap index of each pending kind*/
+    EventHandler handlers[EVENT_COUNT];
+} Scheduler;
+
+/* next_event returns when the earliest pending event is due */
+static inline uint64_t next_event(const Scheduler *sched) {
+    return sched->size > 0 ? sched->heap[0].time : NO_EVENT;
+}
+
+void schedule_event(CPU *cpu, uint8_t kind, uint64_t time, EventHandler handler);
+void cancel_event(CPU *cpu, uint8_t kind);
+void run_events(CPU *cpu);
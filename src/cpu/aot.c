@@ -0,0 +1,88 @@
+// dlopen() is POSIX and not part of C11
+#define _DEFAULT_SOURCE
+
+#include "../../include/handlers.h"
+// handlers.h has to come first
+#include "../../include/aot.h"
+#include "../../include/cartridge.h"
+
+#include <stdint.h>
+
+#ifdef AOT
+
+#ifndef BLOCK_DISPATCH
+#error "AOT=1 needs DISPATCH=blocks or DISPATCH=dynarec"
+#endif
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* load_aot loads an image built by kogaboy-aot for the inserted cartridge
+ * (or the ROM that is currently in memory). Returns false (and keeps
+ * interpreting) if it can't be loaded or was built for another ROM or with
+ * other build options.
+ */
+bool load_aot(CPU *cpu, const char *path) {
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "aot: %s\n", dlerror());
+        return false;
+    }
+
+    const AotModule *module = dlsym(handle, AOT_MODULE_SYMBOL);
+    if (module == NULL) {
+        fprintf(stderr, "aot: %s has no %s\n", path, AOT_MODULE_SYMBOL);
+        dlclose(handle);
+        return false;
+    }
+
+    if (!attach_aot(cpu, module, handle)) {
+        fprintf(stderr, "aot: %s does not match this ROM or build\n", path);
+        dlclose(handle);
+        return false;
+    }
+    return true;
+}
+
+/* attach_aot checks a module against the ROM and the build and makes
+ * run_cycles() use it. The handle is closed by free_cpu().
+ */
+bool attach_aot(CPU *cpu, const AotModule *module, void *handle) {
+    const uint8_t *rom = cpu->cartridge != NULL ? cpu->cartridge->rom : cpu->memory->rom;
+    if (module->abi_version != AOT_ABI_VERSION || module->cpu_size != sizeof(CPU) ||
+        module->build_flags != AOT_BUILD_FLAGS || module->rom_checksum != aot_checksum(rom)) {
+        return false;
+    }
+
+    AotRuntime *aot = calloc(1, sizeof(AotRuntime));
+    if (aot == NULL) {
+        return false;
+    }
+    aot->handle = handle;
+    aot->module = module;
+    aot->rom = rom;
+
+    free_aot(cpu);
+    cpu->aot = aot;
+    return true;
+}
+
+/* Compiled code of a page that was written to no longer matches memory */
+void invalidate_aot_page(CPU *cpu, uint8_t page) {
+    cpu->aot->dirty[page] = true;
+    cpu->code_written = true;
+}
+
+void free_aot(CPU *cpu) {
+    if (cpu->aot == NULL) {
+        return;
+    }
+    if (cpu->aot->handle != NULL) {
+        dlclose(cpu->aot->handle);
+    }
+    free(cpu->aot);
+    cpu->aot = NULL;
+}
+
+#endif
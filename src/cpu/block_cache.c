@@ -0,0 +1,449 @@
+#include "../../include/handlers.h"
+// handlers.h has to come first
+#include "../../include/block_cache.h"
+#include "../../include/cartridge.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef BLOCK_DISPATCH
+
+#define INST_MAX_LENGTH 3
+
+#define BLOCK_END_ENTRY(opcode, kind, bit_index, jump_cond, target, source)              \
+    [opcode] = kind == JP || kind == JP_HL || kind == JR || kind == CALL || kind == RET || \
+               kind == RETI || kind == RST || kind == EI || kind == HALT || kind == STOP,
+
+/* Opcodes that end a block. Anything outside of the opcode map falls back to
+ * execute() and ends a block as well, the prefix byte is resolved while decoding.
+ * EI and HALT end it so that run_until() sees to them right away.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+__extension__ static const bool block_ends[OPCODE_COUNT] = {
+    [0 ... OPCODE_COUNT - 1] = true,
+    [PREFIX_BYTE] = false,
+    BASE_OPCODES(BLOCK_END_ENTRY)  // NOLINT
+};
+#pragma GCC diagnostic pop
+
+/* How an instruction deals with the flags */
+#define FLAGS_READ 1
+#define FLAGS_WRITTEN 2
+#define MEMORY_WRITTEN 4
+
+/* Every ALU instruction overwrites all of F, so the flags are tracked as a
+ * whole. Instructions that keep some flags (INC/DEC keep C, CCF keeps Z, ...)
+ * count as reading them.
+ */
+static uint8_t flag_use(const Instruction *inst) {
+    uint8_t memory = inst->target >= O_C_IND ? MEMORY_WRITTEN : 0;
+
+    switch (inst->kind) {
+        case ADD:
+        case ADD_HL:
+        case ADD_IND:
+        case ADD_D8:
+        case SUB:
+        case SUB_IND:
+        case SUB_D8:
+        case AND:
+        case AND_IND:
+        case AND_D8:
+        case OR:
+        case OR_IND:
+        case OR_D8:
+        case XOR:
+        case XOR_IND:
+        case XOR_D8:
+        case CP:
+        case CP_IND:
+        case CP_D8:
+        case RRCA:
+        case RLCA:
+        case SRL:
+        case RRC:
+        case RLC:
+        case SRA:
+        case SLA:
+        case SWAP:
+            return FLAGS_WRITTEN | memory;
+        case ADC:
+        case ADC_IND:
+        case ADC_D8:
+        case SBC:
+        case SBC_IND:
+        case SBC_D8:
+        case CCF:
+        case SCF:
+        case RRA:
+        case RLA:
+        case CPL:
+        case BIT:
+        case RR:
+        case RL:
+            return FLAGS_READ | FLAGS_WRITTEN | memory;
+        case INC:
+        case DEC:
+            // 16-bit INC/DEC leave the flags alone
+            return inst->source < O_AF ? FLAGS_READ | FLAGS_WRITTEN : 0;
+        case INC_IND:
+        case DEC_IND:
+            return FLAGS_READ | FLAGS_WRITTEN | MEMORY_WRITTEN;
+        case JP:
+        case JR:
+        case RET:
+            return inst->jump_cond != ALWAYS ? FLAGS_READ : 0;
+        case CALL:
+            return (inst->jump_cond != ALWAYS ? FLAGS_READ : 0) | MEMORY_WRITTEN;
+        case PUSH:
+            return (inst->source == O_AF ? FLAGS_READ : 0) | MEMORY_WRITTEN;
+        case POP:
+            return inst->target == O_AF ? FLAGS_WRITTEN : 0;
+        case RST:
+            return MEMORY_WRITTEN;
+        case RESET:
+        case SET:
+        case LD_REG:
+        case LD_D8:
+        case LD_D16:
+        case LD_D8_IND:
+        case LD_IND:
+        case LD_ADDR:
+        case LD_INC:
+        case LD_DEC:
+        case LDH_IND:
+        case LDH_ADDR:
+            return memory;
+        case JP_HL:
+        case RETI:
+        case DI:
+        case EI:
+        case HALT:
+        case STOP:
+        case NOP:
+            return 0;
+        default:
+            return FLAGS_READ | FLAGS_WRITTEN | MEMORY_WRITTEN;
+    }
+}
+
+/* Flag liveness
+ *
+ * Walks the block backwards to find instructions whose flags are overwritten
+ * before anything reads them and switches those to their flag-free handler.
+ *
+ * The flags are live at the end of a block, since the next block may read them,
+ * and after every instruction that writes memory, since a block is left right
+ * after one of its instructions overwrote cached code.
+ */
+static void drop_dead_flags(Block *block, const uint8_t *inst_bytes, const uint8_t *flag_uses) {
+    bool live = true;
+    for (int i = block->inst_count - 1; i >= 0; i--) {
+        uint8_t use = flag_uses[i];
+        if (use & MEMORY_WRITTEN) {
+            live = true;
+        }
+        if (use & FLAGS_WRITTEN) {
+            if (!live && nf_op_handlers[inst_bytes[i]] != NULL) {
+                block->insts[i].handler = nf_op_handlers[inst_bytes[i]];
+            }
+            live = false;
+        }
+        if (use & FLAGS_READ) {
+            live = true;
+        }
+    }
+}
+
+/* Superinstructions
+ *
+ * A fused handler runs the handlers of its opcodes one after the other.
+ * Its BlockInst only holds the cycles of the first opcode, the handler adds
+ * those of every later opcode right before running it, so anything looking
+ * at cpu->cycles from inside of a handler sees the same count as without
+ * fusing. Parts that write memory are followed by the same code write check
+ * as in the block loop.
+ */
+#define FUSED_MAX_OPS 5
+
+#define FUSED_PART(opcode)                \
+    cpu->cycles += inst_cycles[opcode];   \
+    cpu->registers.pc = op_##opcode(cpu);
+#define FUSED_LAST(opcode)              \
+    cpu->cycles += inst_cycles[opcode]; \
+    return op_##opcode(cpu);
+
+// NOLINTBEGIN
+#define DEFINE_FUSED2(name, first, second)   \
+    static uint16_t fused_##name(CPU *cpu) { \
+        cpu->registers.pc = op_##first(cpu); \
+        FUSED_LAST(second)                   \
+    }
+#define DEFINE_FUSED3(name, first, second, third) \
+    static uint16_t fused_##name(CPU *cpu) {      \
+        cpu->registers.pc = op_##first(cpu);      \
+        FUSED_PART(second)                        \
+        FUSED_LAST(third)                         \
+    }
+
+/* CP d8, JR cc */
+DEFINE_FUSED2(cp_jr_nz, 0xFE, 0x20)
+DEFINE_FUSED2(cp_jr_z, 0xFE, 0x28)
+DEFINE_FUSED2(cp_jr_nc, 0xFE, 0x30)
+DEFINE_FUSED2(cp_jr_c, 0xFE, 0x38)
+
+/* LDH A, (a8), CP d8 / AND d8, JR NZ / JR Z */
+DEFINE_FUSED3(poll_cp_jr_nz, 0xF0, 0xFE, 0x20)
+DEFINE_FUSED3(poll_cp_jr_z, 0xF0, 0xFE, 0x28)
+DEFINE_FUSED3(poll_and_jr_nz, 0xF0, 0xE6, 0x20)
+DEFINE_FUSED3(poll_and_jr_z, 0xF0, 0xE6, 0x28)
+// NOLINTEND
+
+/* LD A, (HL+), LD (DE), A, INC DE, DEC B, JR NZ */
+static uint16_t fused_copy_loop(CPU *cpu) {
+    cpu->registers.pc = op_0x2A(cpu);
+    FUSED_PART(0x12)
+    if (cpu->code_written) {
+        return cpu->registers.pc;
+    }
+    FUSED_PART(0x13)
+    FUSED_PART(0x05)
+    FUSED_LAST(0x20)
+}
+
+typedef struct {
+    uint8_t op_count;
+    uint8_t opcodes[FUSED_MAX_OPS];
+    OpHandler handler;
+} FusedPattern;
+
+/* Longer patterns come first, so they win over their own tails */
+static const FusedPattern fused_patterns[] = {
+    {5, {0x2A, 0x12, 0x13, 0x05, 0x20}, fused_copy_loop},
+    {3, {0xF0, 0xFE, 0x20}, fused_poll_cp_jr_nz},
+    {3, {0xF0, 0xFE, 0x28}, fused_poll_cp_jr_z},
+    {3, {0xF0, 0xE6, 0x20}, fused_poll_and_jr_nz},
+    {3, {0xF0, 0xE6, 0x28}, fused_poll_and_jr_z},
+    {2, {0xFE, 0x20}, fused_cp_jr_nz},
+    {2, {0xFE, 0x28}, fused_cp_jr_z},
+    {2, {0xFE, 0x30}, fused_cp_jr_nc},
+    {2, {0xFE, 0x38}, fused_cp_jr_c},
+};
+
+#define FUSED_PATTERN_COUNT (sizeof(fused_patterns) / sizeof(fused_patterns[0]))
+
+static const FusedPattern *match_pattern(const uint8_t *inst_bytes, int inst_count) {
+    for (size_t p = 0; p < FUSED_PATTERN_COUNT; p++) {
+        const FusedPattern *pattern = &fused_patterns[p];
+        if (pattern->op_count <= inst_count &&
+            memcmp(pattern->opcodes, inst_bytes, pattern->op_count) == 0) {
+            return pattern;
+        }
+    }
+    return NULL;
+}
+
+/* Replaces every known idiom in the block by its superinstruction */
+static void fuse_insts(Block *block, const uint8_t *inst_bytes) {
+    int count = 0;
+    for (int i = 0; i < block->inst_count; count++) {
+        const FusedPattern *pattern = match_pattern(&inst_bytes[i], block->inst_count - i);
+        BlockInst *fused = &block->insts[count];
+        *fused = block->insts[i];
+        if (pattern == NULL) {
+            i++;
+            continue;
+        }
+
+        fused->handler = pattern->handler;
+        fused->op_count = pattern->op_count;
+        for (int part = 1; part < pattern->op_count; part++) {
+            fused->length += block->insts[i + part].length;
+        }
+        i += pattern->op_count;
+    }
+    block->inst_count = count;
+}
+
+/* Code that different banks have at the same address is told apart
+ * by the bank the MBC currently maps there.
+ */
+static uint16_t code_bank(const CPU *cpu, uint16_t pc) {
+    return cpu->mbc != NULL ? mbc_bank(cpu->mbc, pc) : 0;
+}
+
+static Block *block_slot(BlockCache *cache, uint16_t bank, uint16_t pc) {
+    uint16_t hash = pc ^ (pc >> 10) ^ ((uint16_t)bank << 4);  // NOLINT
+    return &cache->blocks[hash & (BLOCK_CACHE_SIZE - 1)];
+}
+
+/* Echo RAM is the same memory as the start of WRAM, so code decoded
+ * from an echo page is tracked under the WRAM page it mirrors.
+ */
+static uint8_t code_page(uint16_t addr) {
+    if (addr >= ECHO_START && addr < ECHO_START + ECHO_SIZE) {
+        addr -= ECHO_START - WRAM_START;
+    }
+    return addr >> BYTE_SIZE;
+}
+
+/* The echo page of a WRAM page, or the page itself if it has none */
+static uint8_t echo_page(uint8_t page) {
+    if (page >= WRAM_START >> BYTE_SIZE && page < (WRAM_START + ECHO_SIZE) >> BYTE_SIZE) {
+        return page + ((ECHO_START - WRAM_START) >> BYTE_SIZE);
+    }
+    return page;
+}
+
+/* Writes to either alias have to find code decoded from the page */
+static void mark_code_page(CPU *cpu, uint16_t addr) {
+    uint8_t page = code_page(addr);
+    cpu->code_pages[page] = 1;
+    cpu->code_pages[echo_page(page)] = 1;
+}
+
+/* Whether an instruction at addr can have bytes in the I/O registers. Those
+ * change without being written to, so code there is never cached.
+ */
+static bool in_registers(uint16_t addr) {
+    return addr + INST_MAX_LENGTH > IO_START && addr < HRAM_START;
+}
+
+static void flush_blocks(CPU *cpu) {
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        cpu->block_cache->blocks[i].valid = false;
+    }
+    for (int page = 0; page < PAGE_COUNT; page++) {
+        cpu->code_pages[page] = 0;
+    }
+}
+
+static void decode_block(CPU *cpu, Block *block, uint16_t bank, uint16_t pc) {
+    uint16_t addr = pc;
+    bool end = false;
+    uint8_t inst_bytes[BLOCK_MAX_INSTS];
+    uint8_t flag_uses[BLOCK_MAX_INSTS];
+
+    block->bank = bank;
+    block->start = pc;
+    block->inst_count = 0;
+    block->cycles = 0;
+
+    while (!end && block->inst_count < BLOCK_MAX_INSTS) {
+        // Leave the breakpoint to the start of a block so run_cycles() can stop there
+        if (block->inst_count > 0 && addr == cpu->breakpoint) {
+            break;
+        }
+        // The block is keyed by a single bank, so it can't run on into the next bank window
+        if (block->inst_count > 0 && ((addr ^ pc) & ~(BANK_WINDOW_SIZE - 1))) {
+            break;
+        }
+        if (block->inst_count > 0 && in_registers(addr)) {
+            break;
+        }
+
+        BlockInst *inst = &block->insts[block->inst_count];
+        uint8_t inst_byte = mem_read(cpu, addr);
+        inst_bytes[block->inst_count] = inst_byte;
+        if (inst_byte == PREFIX_BYTE) {
+            uint8_t pf_byte = mem_read(cpu, (uint16_t)(addr + 1));
+            inst->handler = pf_op_handlers[pf_byte];
+            inst->length = 2;
+            inst->cycles = pf_inst_cycles[pf_byte];
+            inst->op_count = 1;
+            flag_uses[block->inst_count] = flag_use(&pf_inst_table[pf_byte]);
+        } else {
+            inst->handler = op_handlers[inst_byte];
+            inst->length = inst_lengths[inst_byte];
+            inst->cycles = inst_cycles[inst_byte];
+            inst->op_count = 1;
+            flag_uses[block->inst_count] = flag_use(&inst_table[inst_byte]);
+            end = block_ends[inst_byte];
+        }
+        block->inst_count++;
+
+        block->cycles += inst->cycles;
+        addr += inst->length;
+    }
+
+    block->end = addr;
+    block->valid = true;
+    drop_dead_flags(block, inst_bytes, flag_uses);
+    fuse_insts(block, inst_bytes);
+#ifdef DYNAREC
+    block->hits = 0;
+    block->no_native = false;
+    block->native = NULL;
+#endif
+
+    // A block spans at most two pages
+    mark_code_page(cpu, pc);
+    mark_code_page(cpu, addr - 1);
+}
+
+/* get_block returns the cached block starting at pc and decodes it on
+ * a miss. Returns NULL if the cache could not be allocated or pc is in
+ * the I/O registers.
+ */
+Block *get_block(CPU *cpu, uint16_t pc) {
+    if (in_registers(pc)) {
+        return NULL;
+    }
+    if (cpu->block_cache == NULL) {
+        cpu->block_cache = calloc(1, sizeof(BlockCache));
+        if (cpu->block_cache == NULL) {
+            return NULL;
+        }
+        cpu->block_cache->breakpoint = cpu->breakpoint;
+    }
+
+    // Blocks were split at the old breakpoint
+    if (cpu->block_cache->breakpoint != cpu->breakpoint) {
+        flush_blocks(cpu);
+        cpu->block_cache->breakpoint = cpu->breakpoint;
+    }
+
+    uint16_t bank = code_bank(cpu, pc);
+    Block *block = block_slot(cpu->block_cache, bank, pc);
+    if (!block->valid || block->start != pc || block->bank != bank) {
+        decode_block(cpu, block, bank, pc);
+    }
+
+    return block;
+}
+
+void free_block_cache(CPU *cpu) {
+    if (cpu->block_cache == NULL) {
+        return;
+    }
+#ifdef DYNAREC
+    free_dynarec(cpu->block_cache);
+#endif
+    free(cpu->block_cache);
+    cpu->block_cache = NULL;
+}
+
+/* Drops every cached block that was decoded from the given page */
+void invalidate_code_page(CPU *cpu, uint8_t page) {
+    page = code_page(page << BYTE_SIZE);
+    cpu->code_pages[page] = 0;
+    cpu->code_pages[echo_page(page)] = 0;
+    cpu->code_written = true;
+    if (cpu->block_cache == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        Block *block = &cpu->block_cache->blocks[i];
+        uint8_t first_page = code_page(block->start);
+        uint8_t last_page = code_page(block->end - 1);
+        if (block->valid && (first_page == page || last_page == page)) {
+            block->valid = false;
+        }
+    }
+}
+
+#endif
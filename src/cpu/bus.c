@@ -0,0 +1,107 @@
+#include "../../include/cpu.h"
+
+#include <stdint.h>
+
+#define OPEN_BUS 0xFF
+
+/* map_memory maps every region of the CPU's Memory to its place
+ * in the address space. Echo RAM pages point at the same WRAM pages,
+ * so the mirror costs nothing on reads or writes.
+ */
+void map_memory(CPU *cpu) {
+    Memory *memory = cpu->memory;
+
+    map_handlers(cpu, 0, PAGE_COUNT, open_bus_read, open_bus_write);
+    map_pages(cpu, ROM_START >> BYTE_SIZE, ROM_SIZE / PAGE_SIZE, memory->rom, memory->rom);
+    map_pages(cpu, VRAM_START >> BYTE_SIZE, VRAM_SIZE / PAGE_SIZE, memory->vram, memory->vram);
+    map_pages(cpu, SRAM_START >> BYTE_SIZE, SRAM_SIZE / PAGE_SIZE, memory->sram, memory->sram);
+    map_pages(cpu, WRAM_START >> BYTE_SIZE, WRAM_SIZE / PAGE_SIZE, memory->wram, memory->wram);
+    map_pages(cpu, ECHO_START >> BYTE_SIZE, ECHO_SIZE / PAGE_SIZE, memory->wram, memory->wram);
+    map_pages(cpu, OAM_START >> BYTE_SIZE, 1, memory->oam, memory->oam);
+    map_handlers(cpu, IO_START >> BYTE_SIZE, 1, io_read, io_write);
+}
+
+/* map_pages points count pages starting at page straight at host memory,
+ * read and write each cover count * PAGE_SIZE bytes. Passing NULL for one
+ * of them routes that kind of access to the pages' handlers instead.
+ */
+void map_pages(CPU *cpu, uint8_t page, uint16_t count, const uint8_t *read, uint8_t *write) {
+    for (uint16_t i = 0; i < count && page + i < PAGE_COUNT; i++) {
+        cpu->memory->bus.read_pages[page + i] = read != NULL ? read + i * PAGE_SIZE : NULL;
+        cpu->memory->bus.write_pages[page + i] = write != NULL ? write + i * PAGE_SIZE : NULL;
+    }
+#ifdef FASTMEM
+    sync_fastmem(cpu, page, count);
+#endif
+}
+
+/* map_handlers routes reads and/or writes of count pages starting at page
+ * to a handler. A NULL handler leaves that kind of access as it was.
+ */
+void map_handlers(CPU *cpu, uint8_t page, uint16_t count, BusRead read, BusWrite write) {
+    for (uint16_t i = 0; i < count && page + i < PAGE_COUNT; i++) {
+        if (read != NULL) {
+            cpu->memory->bus.read_pages[page + i] = NULL;
+            cpu->memory->bus.read_handlers[page + i] = read;
+        }
+        if (write != NULL) {
+            cpu->memory->bus.write_pages[page + i] = NULL;
+            cpu->memory->bus.write_handlers[page + i] = write;
+        }
+    }
+#ifdef FASTMEM
+    sync_fastmem(cpu, page, count);
+#endif
+}
+
+/* rebase_bus moves the pages that point into the size bytes at from
+ * over to the same offsets in to, e.g. for a copy of a CPU with its own memory.
+ */
+void rebase_bus(Bus *bus, const uint8_t *from, uint8_t *to, uint32_t size) {
+    for (uint16_t page = 0; page < PAGE_COUNT; page++) {
+        if (bus->read_pages[page] >= from && bus->read_pages[page] < from + size) {
+            bus->read_pages[page] = to + (bus->read_pages[page] - from);
+        }
+        if (bus->write_pages[page] >= from && bus->write_pages[page] < from + size) {
+            bus->write_pages[page] = to + (bus->write_pages[page] - from);
+        }
+    }
+}
+
+/* The page with the I/O registers, see io.h */
+uint8_t io_read(CPU *cpu, uint16_t addr) {
+    if (addr >= IO_DIV && addr <= IO_TAC) {
+        return read_timer(cpu, addr);
+    }
+    if (addr == IO_IF) {
+        sync_timer(cpu);
+        return cpu->memory->high[addr & BYTE_M] | IF_UNUSED_M;
+    }
+    return cpu->memory->high[addr & BYTE_M];
+}
+
+/* HRAM can hold code, so plain writes drop it like mem_write() does */
+void io_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    if (addr >= IO_DIV && addr <= IO_TAC) {
+        write_timer(cpu, addr, val);
+        return;
+    }
+    cpu->memory->high[addr & BYTE_M] = val;
+    wrote_memory(cpu, addr);
+    if (addr == IO_IF || addr == IO_IE) {
+        update_interrupts(cpu);
+    }
+}
+
+/* Nothing answers on unmapped addresses, so the data lines read high */
+uint8_t open_bus_read(CPU *cpu, uint16_t addr) {
+    (void)cpu;
+    (void)addr;
+    return OPEN_BUS;
+}
+
+void open_bus_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    (void)cpu;
+    (void)addr;
+    (void)val;
+}
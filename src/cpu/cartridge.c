@@ -0,0 +1,195 @@
+// mmap() is POSIX and not part of C11
+#define _DEFAULT_SOURCE
+
+#include "../../include/cpu.h"
+// cpu.h has to come first
+#include "../../include/cartridge.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_ROM_SIZE_CODE 8
+
+/* External RAM banks by the RAM size code of the header, code 1 is an
+ * unofficial 2 KiB that still takes up a bank.
+ */
+static const uint8_t ram_bank_counts[] = {0, 1, 1, 4, 16, 8};
+
+/* Memory bank controller by the cartridge type of the header,
+ * returns false for types that aren't supported.
+ */
+static bool mbc_kind(uint8_t type, uint8_t *kind) {
+    switch (type) {
+        case 0x00:  // ROM ONLY
+        case 0x08:  // ROM+RAM
+        case 0x09:  // ROM+RAM+BATTERY
+            *kind = MBC_NONE;
+            return true;
+        case 0x01:  // MBC1
+        case 0x02:  // MBC1+RAM
+        case 0x03:  // MBC1+RAM+BATTERY
+            *kind = MBC_1;
+            return true;
+        case 0x05:  // MBC2
+        case 0x06:  // MBC2+BATTERY
+            *kind = MBC_2;
+            return true;
+        case 0x0F:  // MBC3+TIMER+BATTERY
+        case 0x10:  // MBC3+TIMER+RAM+BATTERY
+        case 0x11:  // MBC3
+        case 0x12:  // MBC3+RAM
+        case 0x13:  // MBC3+RAM+BATTERY
+            *kind = MBC_3;
+            return true;
+        case 0x19:  // MBC5
+        case 0x1A:  // MBC5+RAM
+        case 0x1B:  // MBC5+RAM+BATTERY
+        case 0x1C:  // MBC5+RUMBLE
+        case 0x1D:  // MBC5+RUMBLE+RAM
+        case 0x1E:  // MBC5+RUMBLE+RAM+BATTERY
+            *kind = MBC_5;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Whether the cartridge type keeps its RAM powered by a battery */
+static bool has_battery(uint8_t type) {
+    switch (type) {
+        case 0x03:  // MBC1+RAM+BATTERY
+        case 0x06:  // MBC2+BATTERY
+        case 0x09:  // ROM+RAM+BATTERY
+        case 0x0F:  // MBC3+TIMER+BATTERY
+        case 0x10:  // MBC3+TIMER+RAM+BATTERY
+        case 0x13:  // MBC3+RAM+BATTERY
+        case 0x1B:  // MBC5+RAM+BATTERY
+        case 0x1E:  // MBC5+RUMBLE+RAM+BATTERY
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* The boot ROM refuses to start a cartridge whose header checksum is off */
+static uint8_t header_checksum(const uint8_t *rom) {
+    uint8_t checksum = 0;
+    for (uint16_t addr = HEADER_TITLE; addr < HEADER_CHECKSUM; addr++) {
+        checksum = checksum - rom[addr] - 1;
+    }
+    return checksum;
+}
+
+static bool parse_header(Cartridge *cart, const char *path) {
+    const uint8_t *rom = cart->rom;
+
+    if (header_checksum(rom) != rom[HEADER_CHECKSUM]) {
+        fprintf(stderr, "%s: bad header checksum\n", path);
+        return false;
+    }
+
+    uint8_t rom_size = rom[HEADER_ROM_SIZE];
+    if (rom_size > MAX_ROM_SIZE_CODE || cart->rom_size < (size_t)ROM_SIZE << rom_size) {
+        fprintf(stderr, "%s: ROM is smaller than its header says\n", path);
+        return false;
+    }
+
+    uint8_t ram_size = rom[HEADER_RAM_SIZE];
+    if (ram_size >= sizeof(ram_bank_counts)) {
+        fprintf(stderr, "%s: unknown RAM size 0x%02X\n", path, ram_size);
+        return false;
+    }
+
+    if (!mbc_kind(rom[HEADER_TYPE], &cart->mbc)) {
+        fprintf(stderr, "%s: unsupported cartridge type 0x%02X\n", path, rom[HEADER_TYPE]);
+        return false;
+    }
+
+    cart->rom_banks = 2 << rom_size;
+    cart->ram_banks = ram_bank_counts[ram_size];
+    cart->type = rom[HEADER_TYPE];
+    cart->battery = has_battery(cart->type);
+    cart->global_checksum = rom[HEADER_GLOBAL_CHECKSUM] << BYTE_SIZE |
+                            rom[HEADER_GLOBAL_CHECKSUM + 1];
+    memcpy(cart->title, rom + HEADER_TITLE, HEADER_TITLE_SIZE);
+    return true;
+}
+
+/* load_cartridge maps the ROM file at path, returns NULL
+ * if it can't be mapped or its header is broken.
+ */
+Cartridge *load_cartridge(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size < ROM_SIZE) {
+        fprintf(stderr, "%s: too small for a ROM\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping stays valid after the file is closed. It is shared so a
+    // fastmem window can map it again, it's never written either way.
+    void *rom = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (rom == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+
+    Cartridge *cart = calloc(1, sizeof(Cartridge));
+    if (cart == NULL) {
+        munmap(rom, st.st_size);
+        return NULL;
+    }
+    cart->rom = rom;
+    cart->rom_size = st.st_size;
+
+    if (!parse_header(cart, path)) {
+        free_cartridge(cart);
+        return NULL;
+    }
+    return cart;
+}
+
+void free_cartridge(Cartridge *cart) {
+    if (cart == NULL) {
+        return;
+    }
+    munmap((void *)cart->rom, cart->rom_size);
+    free(cart);
+}
+
+/* insert_cartridge maps the cartridge's ROM and RAM through its MBC.
+ * Code cached or compiled from the previous contents of ROM is dropped.
+ * Returns false if the cartridge RAM can't be allocated.
+ */
+bool insert_cartridge(CPU *cpu, Cartridge *cart) {
+#ifdef BLOCK_DISPATCH
+    free_block_cache(cpu);
+#endif
+#ifdef AOT
+    free_aot(cpu);
+#endif
+
+    if (!init_mbc(cpu, cart)) {
+        return false;
+    }
+    cpu->cartridge = cart;
+    return true;
+}
@@ -1,29 +1,78 @@
-#include "../../include/cpu.h"
+#include "../../include/handlers.h"
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 CPU new_cpu(void) {
-    Registers regs = new_regs();
-    FlagRegister flag_reg = new_flag_reg();
-    CPU cpu = {regs, flag_reg, 0, 0, {0}};
+    // Everything not set below starts out zeroed
+    CPU cpu = {0};
+    cpu.registers = new_regs();
+    cpu.breakpoint = NO_BREAKPOINT;
+
+    // Memory and the bus live outside of the CPU, so returning it copies little
+    cpu.memory = alloc_memory(sizeof(Memory));
+    if (cpu.memory == NULL) {
+        perror("new_cpu");
+        abort();
+    }
+#ifdef FASTMEM
+    init_fastmem(&cpu);
+#endif
+    map_memory(&cpu);
     return cpu;
 }
 
-void step(CPU *cpu) {
-    uint8_t inst_byte = cpu->memory[cpu->prog_count];
+/* free_cpu releases the memory of a CPU and what it allocated while running,
+ * copies of a CPU share these allocations.
+ */
+void free_cpu(CPU *cpu) {
+#ifdef BLOCK_DISPATCH
+    free_block_cache(cpu);
+#endif
+#ifdef AOT
+    free_aot(cpu);
+#endif
+    free_mbc(cpu);
+#ifdef FASTMEM
+    free_fastmem(cpu);
+#endif
+    free_memory(cpu->memory, sizeof(Memory));
+    cpu->memory = NULL;
+}
 
-    Instruction inst;
+/* load_program writes a program to memory at the program counter,
+ * the same way the running program would write it.
+ */
+void load_program(CPU *cpu, const uint8_t *program, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        mem_write(cpu, cpu->registers.pc + i, program[i]);
+    }
+}
 
-    // Prefix instructions start with 0xCB
-    if (inst_byte == PREFIX_BYTE) {
-        inst_byte = cpu->memory[cpu->prog_count + 1];
-        inst = pf_inst_from_byte(inst_byte);
-    } else {
-        inst = inst_from_byte(inst_byte);
+/* step executes a single instruction, or dispatches a pending interrupt
+ * instead, and returns the T-cycles it took.
+ */
+uint32_t step(CPU *cpu) {
+    uint64_t start = cpu->cycles;
+
+    // A single step doesn't skip ahead in HALT
+    cpu->limit = cpu->cycles;
+    if (!handle_interrupts(cpu)) {
+        bool enabling = cpu->ei_delay;
+        uint8_t inst_byte = mem_read(cpu, cpu->registers.pc);
+
+        // Prefix instructions start with 0xCB, their handler
+        // takes care of decoding the byte following the prefix
+        cpu->cycles += inst_cycles[inst_byte];
+        cpu->registers.pc = op_handlers[inst_byte](cpu);
+        if (enabling) {
+            finish_ei(cpu);
+        }
     }
+    run_events(cpu);
 
-    cpu->prog_count = execute(cpu, &inst);
+    return (uint32_t)(cpu->cycles - start);
 }
 
 uint16_t execute(CPU *cpu, const Instruction *instruction) {
@@ -31,147 +80,147 @@ uint16_t execute(CPU *cpu, const Instruction *instruction) {
         /* Arithmetic Instructions */
         case ADD:
             add(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case ADD_HL:
             add_hl(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case ADD_IND:
             add_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case ADD_D8:
             add_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case ADC:
             adc(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case ADC_IND:
             adc_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case ADC_D8:
             adc_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case SUB:
             sub(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case SUB_IND:
             sub_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case SUB_D8:
             sub_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case SBC:
             sbc(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case SBC_IND:
             sbc_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case SBC_D8:
             sbc_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case AND:
             and_(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case AND_IND:
             and_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case AND_D8:
             and_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case OR:
             or_(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case OR_IND:
             or_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case OR_D8:
             or_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case XOR:
             xor_(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case XOR_IND:
             xor_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case XOR_D8:
             xor_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case CP:
             cp(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case CP_IND:
             cp_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case CP_D8:
             cp_d8(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case INC:
             inc(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case INC_IND:
             inc_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case DEC:
             dec(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case DEC_IND:
             dec_ind(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case CCF:
             ccf(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case SCF:
             scf(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case RRA:
             rra(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case RLA:
             rla(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case RRCA:
             rrca(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case RLCA:
             rlca(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case CPL:
             cpl(cpu);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
 
         /* Prefix Instructions */
         case BIT:
             bit(cpu, instruction->bit_index, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case RESET:
             reset(cpu, instruction->bit_index, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case SET:
             set(cpu, instruction->bit_index, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case SRL:
             srl(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case RR:
             rr(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case RL:
             rl(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case RRC:
             rrc(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case RLC:
             rlc(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case SRA:
             sra(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case SLA:
             sla(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case SWAP:
             swap(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
 
         /* Jump Instructions */
         case JP:
@@ -184,52 +233,68 @@ uint16_t execute(CPU *cpu, const Instruction *instruction) {
         /* Load Instructions */
         case LD_REG:
             ld_reg(cpu, instruction->target, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case LD_D8:
             ld_d8(cpu, instruction->target);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case LD_D16:
             ld_d16(cpu, instruction->target);
-            return cpu->prog_count + 3;
+            return cpu->registers.pc + 3;
         case LD_D8_IND:
             ld_d8_ind(cpu);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case LD_IND:
             ld_ind(cpu, instruction->target, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case LD_ADDR:
             ld_addr(cpu, instruction->target, instruction->source);
-            return cpu->prog_count + 3;
+            return cpu->registers.pc + 3;
         case LD_INC:
             ld_inc(cpu, instruction->target, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case LD_DEC:
             ld_dec(cpu, instruction->target, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case LDH_IND:
             ldh_ind(cpu, instruction->target, instruction->source);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
         case LDH_ADDR:
             ldh_addr(cpu, instruction->target, instruction->source);
-            return cpu->prog_count + 2;
+            return cpu->registers.pc + 2;
 
         /* Stack Instructions */
         case PUSH:
             push(cpu, instruction->source);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
         case POP:
             pop(cpu, instruction->target);
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
 
         /* Call and Return Instructions */
         case CALL:
             return call(cpu, instruction->jump_cond);
         case RET:
             return ret(cpu, instruction->jump_cond);
+        case RETI:
+            return reti(cpu);
+        case RST:
+            return rst(cpu, instruction->bit_index);
+
+        /* Interrupt and CPU Control Instructions */
+        case DI:
+            di(cpu);
+            return cpu->registers.pc + 1;
+        case EI:
+            ei(cpu);
+            return cpu->registers.pc + 1;
+        case HALT:
+            return halt(cpu);
+        case STOP:
+            return stop(cpu);
 
         /* No Op Instruction */
         case NOP:
-            return cpu->prog_count + 1;
+            return cpu->registers.pc + 1;
     }
 
     return 0;
@@ -248,21 +313,23 @@ uint16_t get_reg(CPU *cpu, enum RegisterName reg) {
         case E:
             return cpu->registers.e;
         case F:
+            sync_flags(cpu);
             return cpu->registers.f;
         case H:
             return cpu->registers.h;
         case L:
             return cpu->registers.l;
         case AF:
-            return get_af(&cpu->registers);
+            sync_flags(cpu);
+            return cpu->registers.af;
         case BC:
-            return get_bc(&cpu->registers);
+            return cpu->registers.bc;
         case DE:
-            return get_de(&cpu->registers);
+            return cpu->registers.de;
         case HL:
-            return get_hl(&cpu->registers);
+            return cpu->registers.hl;
         case SP:
-            return cpu->stack_pointer;
+            return cpu->registers.sp;
     }
     return 0;
 }
@@ -285,6 +352,7 @@ void set_reg(CPU *cpu, enum RegisterName reg, uint16_t val) {  // NOLINT
             cpu->registers.e = val;
             break;
         case F:
+            drop_flags(cpu);
             cpu->registers.f = val;
             break;
         case H:
@@ -294,19 +362,20 @@ void set_reg(CPU *cpu, enum RegisterName reg, uint16_t val) {  // NOLINT
             cpu->registers.l = val;
             break;
         case AF:
-            set_af(&cpu->registers, val);
+            drop_flags(cpu);
+            cpu->registers.af = val;
             break;
         case BC:
-            set_bc(&cpu->registers, val);
+            cpu->registers.bc = val;
             break;
         case DE:
-            set_de(&cpu->registers, val);
+            cpu->registers.de = val;
             break;
         case HL:
-            set_hl(&cpu->registers, val);
+            cpu->registers.hl = val;
             break;
         case SP:
-            cpu->stack_pointer = val;
+            cpu->registers.sp = val;
     }
 }
 
@@ -330,23 +399,32 @@ void print_regs(CPU *cpu) {
 }
 
 void update_flags(CPU *cpu, bool zero, bool subtract, bool half_carry, bool carry) {
-    cpu->flag_reg.zero = zero;
-    cpu->flag_reg.subtract = subtract;
-    cpu->flag_reg.half_carry = half_carry;
-    cpu->flag_reg.carry = carry;
+    drop_flags(cpu);
+    cpu->registers.f = (uint8_t)(zero << ZERO_BIT_POS | subtract << SUBTRACT_BIT_POS |
+                                 half_carry << HALF_CARRY_BIT_POS | carry << CARRY_BIT_POS);
+}
 
-    cpu->registers.f = flag_reg_to_byte(&cpu->flag_reg);
+void sync_flags(CPU *cpu) {
+#ifdef LAZY_FLAGS
+    if (cpu->lazy_flags.op == FLAG_OP_NONE) {
+        return;
+    }
+    cpu->registers.f = eval_flags(&cpu->lazy_flags);
+    cpu->lazy_flags.op = FLAG_OP_NONE;
+#else
+    (void)cpu;
+#endif
 }
 
 uint8_t read_byte(CPU *cpu) {
-    uint8_t byte = cpu->memory[cpu->prog_count + 1];
+    uint8_t byte = mem_read(cpu, cpu->registers.pc + 1);
 
     return byte;
 }
 
 uint16_t read_bbyte(CPU *cpu) {
-    uint8_t bbyte_lower = cpu->memory[cpu->prog_count + 1];
-    uint8_t bbyte_upper = cpu->memory[cpu->prog_count + 2];
+    uint8_t bbyte_lower = mem_read(cpu, cpu->registers.pc + 1);
+    uint8_t bbyte_upper = mem_read(cpu, cpu->registers.pc + 2);
     uint16_t bbyte = (uint16_t)bbyte_upper << BYTE_SIZE | (uint16_t)bbyte_lower;
 
     return bbyte;
@@ -356,19 +434,19 @@ void stack_push(CPU *cpu, uint16_t val) {
     uint8_t val_upper = (UPPER_BYTE_M & val) >> BYTE_SIZE;
     uint8_t val_lower = BYTE_M & val;
 
-    cpu->stack_pointer -= 1;
-    cpu->memory[cpu->stack_pointer] = val_upper;
+    cpu->registers.sp -= 1;
+    mem_write(cpu, cpu->registers.sp, val_upper);
 
-    cpu->stack_pointer -= 1;
-    cpu->memory[cpu->stack_pointer] = val_lower;
+    cpu->registers.sp -= 1;
+    mem_write(cpu, cpu->registers.sp, val_lower);
 }
 
 uint16_t stack_pop(CPU *cpu) {
-    uint8_t val_lower = cpu->memory[cpu->stack_pointer];
-    cpu->stack_pointer += 1;
+    uint8_t val_lower = mem_read(cpu, cpu->registers.sp);
+    cpu->registers.sp += 1;
 
-    uint8_t val_upper = cpu->memory[cpu->stack_pointer];
-    cpu->stack_pointer += 1;
+    uint8_t val_upper = mem_read(cpu, cpu->registers.sp);
+    cpu->registers.sp += 1;
 
     uint16_t val = (val_upper << BYTE_SIZE) | val_lower;
     return val;
@@ -0,0 +1,566 @@
+// mmap() and MAP_ANONYMOUS are not part of C11
+#define _DEFAULT_SOURCE
+
+#include "../../include/handlers.h"
+// handlers.h has to come first
+#include "../../include/block_cache.h"
+#include "../../include/cartridge.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef DYNAREC
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "The dynarec only supports Linux on x86-64"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* x86-64 dynamic recompiler
+ *
+ * A compiled block is a function void (CPU *cpu) that runs the whole block
+ * and leaves the CPU in the same state as the block interpreter would.
+ *
+ * While it runs, the CPU pointer lives in rbp and the 8-bit registers are
+ * mapped onto the legacy byte registers of the host:
+ *
+ *   A -> al, B -> bh, C -> bl, D -> ch, E -> cl, H -> dh, L -> dl
+ *
+ * so BC, DE and HL are bx, cx and dx. F and SP stay in memory.
+ *
+ * Loads between registers, immediate loads and 16-bit INC/DEC are
+ * emitted as native instructions. Every other instruction, superinstructions
+ * included, is a call to its handler, with the mapped registers written back
+ * to the CPU before and loaded again after the call. Cycles and the program counter
+ * are only written back before such a call and at the end of the block.
+ *
+ * If a handler wrote to cached code, the compiled block returns right
+ * after it, like the block interpreter does.
+ *
+ * The code buffer is never writable and executable at the same time (W^X).
+ * compile_block() makes the pages it emits to writable and turns them back
+ * to read and execute once the block is written, before anything runs it.
+ */
+
+/* Host register numbers as used in ModRM */
+#define HOST_AL 0
+#define HOST_CL 1
+#define HOST_DL 2
+#define HOST_BL 3
+#define HOST_CH 5
+#define HOST_DH 6
+#define HOST_BH 7
+#define HOST_AX 0
+#define HOST_CX 1
+#define HOST_DX 2
+#define HOST_BX 3
+#define HOST_RBP 5
+
+#define NO_HOST_REG 0xFF
+
+// Upper bound of the code emitted for a single block
+#define MAX_NATIVE_BLOCK_SIZE (256 + BLOCK_MAX_INSTS * 160)
+
+typedef struct {
+    uint8_t *pos;
+} Emitter;
+
+/* Host byte register of an 8-bit SM83 register */
+static uint8_t host_reg8(enum Operand reg) {
+    switch (reg) {
+        case O_A:
+            return HOST_AL;
+        case O_B:
+            return HOST_BH;
+        case O_C:
+            return HOST_BL;
+        case O_D:
+            return HOST_CH;
+        case O_E:
+            return HOST_CL;
+        case O_H:
+            return HOST_DH;
+        case O_L:
+            return HOST_DL;
+        default:
+            return NO_HOST_REG;
+    }
+}
+
+/* Host word register of a 16-bit SM83 register, SP is not mapped */
+static uint8_t host_reg16(enum Operand reg) {
+    switch (reg) {
+        case O_BC:
+            return HOST_BX;
+        case O_DE:
+            return HOST_CX;
+        case O_HL:
+            return HOST_DX;
+        default:
+            return NO_HOST_REG;
+    }
+}
+
+static void emit8(Emitter *emit, uint8_t val) { *emit->pos++ = val; }
+
+static void emit16(Emitter *emit, uint16_t val) {
+    memcpy(emit->pos, &val, sizeof(val));
+    emit->pos += sizeof(val);
+}
+
+static void emit32(Emitter *emit, uint32_t val) {
+    memcpy(emit->pos, &val, sizeof(val));
+    emit->pos += sizeof(val);
+}
+
+static void emit64(Emitter *emit, uint64_t val) {
+    memcpy(emit->pos, &val, sizeof(val));
+    emit->pos += sizeof(val);
+}
+
+static uint8_t modrm(uint8_t mod, uint8_t reg, uint8_t rm) { return mod << 6 | reg << 3 | rm; }
+
+/* ModRM + disp32 for [rbp + offset] */
+static void emit_cpu_operand(Emitter *emit, uint8_t reg, size_t offset) {
+    emit8(emit, modrm(2, reg, HOST_RBP));
+    emit32(emit, (uint32_t)offset);
+}
+
+static void emit_store8(Emitter *emit, uint8_t host_reg, size_t offset) {
+    emit8(emit, 0x88);  // mov [rbp + offset], r8
+    emit_cpu_operand(emit, host_reg, offset);
+}
+
+static void emit_load8(Emitter *emit, uint8_t host_reg, size_t offset) {
+    emit8(emit, 0x8A);  // mov r8, [rbp + offset]
+    emit_cpu_operand(emit, host_reg, offset);
+}
+
+static void emit_store16(Emitter *emit, uint8_t host_reg, size_t offset) {
+    emit8(emit, 0x66);
+    emit8(emit, 0x89);  // mov [rbp + offset], r16
+    emit_cpu_operand(emit, host_reg, offset);
+}
+
+static void emit_load16(Emitter *emit, uint8_t host_reg, size_t offset) {
+    emit8(emit, 0x66);
+    emit8(emit, 0x8B);  // mov r16, [rbp + offset]
+    emit_cpu_operand(emit, host_reg, offset);
+}
+
+static void emit_store_imm16(Emitter *emit, uint16_t val, size_t offset) {
+    emit8(emit, 0x66);
+    emit8(emit, 0xC7);  // mov word [rbp + offset], imm16
+    emit_cpu_operand(emit, 0, offset);
+    emit16(emit, val);
+}
+
+static void emit_add_cycles(Emitter *emit, uint32_t cycles) {
+    if (cycles == 0) {
+        return;
+    }
+    emit8(emit, 0x48);
+    emit8(emit, 0x81);  // add qword [rbp + offset], imm32
+    emit_cpu_operand(emit, 0, offsetof(CPU, cycles));
+    emit32(emit, cycles);
+}
+
+/* Write the mapped registers back into cpu->registers */
+static void emit_spill(Emitter *emit) {
+    emit_store8(emit, HOST_AL, offsetof(CPU, registers.a));
+    emit_store16(emit, HOST_BX, offsetof(CPU, registers.bc));
+    emit_store16(emit, HOST_CX, offsetof(CPU, registers.de));
+    emit_store16(emit, HOST_DX, offsetof(CPU, registers.hl));
+}
+
+/* Load the mapped registers from cpu->registers */
+static void emit_reload(Emitter *emit) {
+    emit_load8(emit, HOST_AL, offsetof(CPU, registers.a));
+    emit_load16(emit, HOST_BX, offsetof(CPU, registers.bc));
+    emit_load16(emit, HOST_CX, offsetof(CPU, registers.de));
+    emit_load16(emit, HOST_DX, offsetof(CPU, registers.hl));
+}
+
+/* Emits the instruction at addr natively if it is one of the supported ones.
+ * Returns false (without emitting anything) otherwise.
+ */
+static bool emit_native(Emitter *emit, CPU *cpu, uint16_t addr) {
+    const Instruction *inst = &inst_table[mem_read(cpu, addr)];
+    uint8_t imm_lower = mem_read(cpu, (uint16_t)(addr + 1));
+    uint8_t imm_upper = mem_read(cpu, (uint16_t)(addr + 2));
+    uint8_t target8 = host_reg8(inst->target);
+    uint8_t source8 = host_reg8(inst->source);
+
+    switch (inst->kind) {
+        case NOP:
+            return true;
+
+        case LD_REG:
+            if (target8 == NO_HOST_REG || source8 == NO_HOST_REG) {
+                return false;
+            }
+            emit8(emit, 0x88);  // mov r8, r8
+            emit8(emit, modrm(3, source8, target8));
+            return true;
+
+        case LD_D8:
+            if (target8 == NO_HOST_REG) {
+                return false;
+            }
+            emit8(emit, 0xB0 + target8);  // mov r8, imm8
+            emit8(emit, imm_lower);
+            return true;
+
+        case LD_D16: {
+            uint16_t val = (uint16_t)imm_upper << BYTE_SIZE | imm_lower;
+            if (inst->target == O_SP) {
+                emit_store_imm16(emit, val, offsetof(CPU, registers.sp));
+                return true;
+            }
+            uint8_t target16 = host_reg16(inst->target);
+            if (target16 == NO_HOST_REG) {
+                return false;
+            }
+            emit8(emit, 0x66);
+            emit8(emit, 0xB8 + target16);  // mov r16, imm16
+            emit16(emit, val);
+            return true;
+        }
+
+        // 16-bit INC and DEC leave the flags alone
+        case INC:
+        case DEC: {
+            uint8_t op = inst->kind == INC ? 0 : 1;  // /0 is inc, /1 is dec
+            if (inst->source == O_SP) {
+                emit8(emit, 0x66);
+                emit8(emit, 0xFF);  // inc/dec word [rbp + offset]
+                emit_cpu_operand(emit, op, offsetof(CPU, registers.sp));
+                return true;
+            }
+            uint8_t source16 = host_reg16(inst->source);
+            if (source16 == NO_HOST_REG) {
+                return false;
+            }
+            emit8(emit, 0x66);
+            emit8(emit, 0xFF);  // inc/dec r16
+            emit8(emit, modrm(3, op, source16));
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+/* Blocks accessing the I/O page or wrapping around the end of the
+ * address space are left to the interpreter.
+ */
+static bool compilable(CPU *cpu, const Block *block) {
+    uint32_t addr = block->start;
+    for (int i = 0; i < block->inst_count; i++) {
+        // Superinstructions are checked opcode by opcode
+        for (int op = 0; op < block->insts[i].op_count; op++) {
+            uint8_t inst_byte = mem_read(cpu, addr);
+            uint8_t kind = inst_table[inst_byte].kind;
+            if (kind == LDH_IND || kind == LDH_ADDR) {
+                return false;
+            }
+            addr += inst_lengths[inst_byte];
+            if (addr > UINT16_MAX) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Drops every compiled block and starts filling the buffer from the beginning */
+static void flush_native(BlockCache *cache) {
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        cache->blocks[i].native = NULL;
+        cache->blocks[i].hits = 0;
+    }
+    cache->code_used = 0;
+}
+
+/* Sets the protection of the pages holding size bytes at start */
+static bool protect_code(uint8_t *start, size_t size, int prot) {
+    uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)start & ~(page_size - 1);
+    uintptr_t end = ((uintptr_t)start + size + page_size - 1) & ~(page_size - 1);
+    return mprotect((void *)first, end - first, prot) == 0;
+}
+
+void compile_block(CPU *cpu, Block *block) {
+    BlockCache *cache = cpu->block_cache;
+
+    if (!compilable(cpu, block)) {
+        block->no_native = true;
+        return;
+    }
+
+    if (cache->code == NULL) {
+        void *code = mmap(NULL, DYNAREC_BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+            // Keep interpreting everything
+            block->no_native = true;
+            return;
+        }
+        cache->code = code;
+        cache->code_used = 0;
+    }
+    if (DYNAREC_BUFFER_SIZE - cache->code_used < MAX_NATIVE_BLOCK_SIZE) {
+        flush_native(cache);
+    }
+
+    // Blocks compiled before share the first page, nothing runs them until it is executable again
+    uint8_t *start = cache->code + cache->code_used;
+    if (!protect_code(start, MAX_NATIVE_BLOCK_SIZE, PROT_READ | PROT_WRITE)) {
+        block->no_native = true;
+        return;
+    }
+    Emitter emit = {start};
+    uint8_t *exits[BLOCK_MAX_INSTS];
+    int exit_count = 0;
+
+    /* Prologue, keeps the stack 16 byte aligned for the calls */
+    emit8(&emit, 0x55);  // push rbp
+    emit8(&emit, 0x53);  // push rbx
+    emit8(&emit, 0x48);
+    emit8(&emit, 0x83);
+    emit8(&emit, 0xEC);
+    emit8(&emit, 0x08);  // sub rsp, 8
+    emit8(&emit, 0x48);
+    emit8(&emit, 0x89);
+    emit8(&emit, 0xFD);  // mov rbp, rdi
+    emit_reload(&emit);
+
+    uint16_t addr = block->start;
+    uint32_t pending_cycles = 0;
+    bool spilled = false;
+    for (int i = 0; i < block->inst_count; i++) {
+        const BlockInst *inst = &block->insts[i];
+        bool last = i == block->inst_count - 1;
+        pending_cycles += inst->cycles;
+
+        if (inst->op_count > 1 || !emit_native(&emit, cpu, addr)) {
+            emit_spill(&emit);
+            emit_store_imm16(&emit, addr, offsetof(CPU, registers.pc));
+            emit_add_cycles(&emit, pending_cycles);
+            pending_cycles = 0;
+
+            emit8(&emit, 0x48);
+            emit8(&emit, 0x89);
+            emit8(&emit, 0xEF);  // mov rdi, rbp
+            emit8(&emit, 0x48);
+            emit8(&emit, 0xB8);  // mov rax, imm64
+            emit64(&emit, (uint64_t)(uintptr_t)inst->handler);
+            emit8(&emit, 0xFF);
+            emit8(&emit, 0xD0);  // call rax
+
+            // The handler returns the next program counter
+            emit_store16(&emit, HOST_AX, offsetof(CPU, registers.pc));
+            if (last) {
+                spilled = true;
+            } else {
+                emit8(&emit, 0x80);  // cmp byte [rbp + offset], 0
+                emit_cpu_operand(&emit, 7, offsetof(CPU, code_written));
+                emit8(&emit, 0x00);
+                emit8(&emit, 0x0F);
+                emit8(&emit, 0x85);  // jne exit
+                exits[exit_count++] = emit.pos;
+                emit32(&emit, 0);
+                emit_reload(&emit);
+            }
+        }
+
+        addr += inst->length;
+    }
+
+    if (!spilled) {
+        emit_spill(&emit);
+        emit_store_imm16(&emit, addr, offsetof(CPU, registers.pc));
+        emit_add_cycles(&emit, pending_cycles);
+    }
+
+    /* Epilogue, every early exit jumps here */
+    for (int i = 0; i < exit_count; i++) {
+        uint32_t rel = (uint32_t)(emit.pos - (exits[i] + sizeof(uint32_t)));
+        memcpy(exits[i], &rel, sizeof(rel));
+    }
+    emit8(&emit, 0x48);
+    emit8(&emit, 0x83);
+    emit8(&emit, 0xC4);
+    emit8(&emit, 0x08);  // add rsp, 8
+    emit8(&emit, 0x5B);  // pop rbx
+    emit8(&emit, 0x5D);  // pop rbp
+    emit8(&emit, 0xC3);  // ret
+
+    if (!protect_code(start, (size_t)(emit.pos - start), PROT_READ | PROT_EXEC)) {
+        // The blocks before this one may share its pages, so none of them can run anymore
+        flush_native(cache);
+        block->no_native = true;
+        return;
+    }
+    cache->code_used += (uint32_t)(emit.pos - start);
+    // Object pointers can not be converted to function pointers in ISO C
+    block->native = __extension__(NativeBlock) start;
+}
+
+/* Runs the block the way the block interpreter does */
+static void interpret_block(CPU *cpu, const Block *block) {
+    for (int i = 0; i < block->inst_count && !cpu->code_written; i++) {
+        cpu->cycles += block->insts[i].cycles;
+        cpu->registers.pc = block->insts[i].handler(cpu);
+    }
+}
+
+#ifdef DYNAREC_VERIFY
+/* Gives the shadow its own copy of the MBC registers and the cartridge RAM
+ * (and its dirty pages), which live outside of Memory, so bank switches
+ * and RAM writes of the copy don't reach the real CPU.
+ */
+static bool copy_mbc(BlockCache *cache, CPU *shadow, const CPU *cpu) {
+    const Mbc *mbc = cpu->mbc;
+    Mbc *shadow_mbc = (Mbc *)((Memory *)(shadow + 1) + 1);
+    uint32_t dirty_size = mbc->dirty != NULL ? (mbc->ram_size + PAGE_SIZE - 1) / PAGE_SIZE : 0;
+    uint32_t size = mbc->ram_size + dirty_size * sizeof(bool);
+    if (size > cache->shadow_ram_size) {
+        uint8_t *ram = realloc(cache->shadow_ram, size);
+        if (ram == NULL) {
+            return false;
+        }
+        cache->shadow_ram = ram;
+        cache->shadow_ram_size = size;
+    }
+
+    memcpy(shadow_mbc, mbc, sizeof(Mbc));
+    if (mbc->ram_size > 0) {
+        shadow_mbc->ram = cache->shadow_ram;
+        memcpy(shadow_mbc->ram, mbc->ram, mbc->ram_size);
+        rebase_bus(&shadow->memory->bus, mbc->ram, shadow_mbc->ram, mbc->ram_size);
+    }
+    if (mbc->dirty != NULL) {
+        shadow_mbc->dirty = (bool *)(cache->shadow_ram + mbc->ram_size);
+        memcpy(shadow_mbc->dirty, mbc->dirty, dirty_size * sizeof(bool));
+    }
+    shadow->mbc = shadow_mbc;
+    return true;
+}
+
+static bool same_mbc(const Mbc *shadow, const Mbc *mbc) {
+    Mbc registers;
+    memcpy(&registers, shadow, sizeof(Mbc));
+    registers.ram = mbc->ram;
+    registers.dirty = mbc->dirty;
+    // The two runs may read the host's clock in different seconds
+    registers.rtc.base_time = mbc->rtc.base_time;
+    registers.rtc.halted_time = mbc->rtc.halted_time;
+    if (memcmp(&registers, mbc, sizeof(Mbc)) != 0) {
+        return false;
+    }
+
+    uint32_t dirty_size = mbc->dirty != NULL ? (mbc->ram_size + PAGE_SIZE - 1) / PAGE_SIZE : 0;
+    return (mbc->ram_size == 0 || memcmp(shadow->ram, mbc->ram, mbc->ram_size) == 0) &&
+           (dirty_size == 0 || memcmp(shadow->dirty, mbc->dirty, dirty_size * sizeof(bool)) == 0);
+}
+
+/* Runs the block on a copy of the CPU through the interpreter and
+ * aborts if the compiled block ends up in a different state.
+ */
+static void verify_native(CPU *cpu, Block *block) {
+    BlockCache *cache = cpu->block_cache;
+    if (cache->shadow == NULL) {
+        cache->shadow = malloc(sizeof(CPU) + sizeof(Memory) + sizeof(Mbc));
+        if (cache->shadow == NULL) {
+            block->native(cpu);
+            return;
+        }
+    }
+
+    // The copy must not touch the block cache, but still notice code writes.
+    // Its memory and MBC follow it in the same allocation.
+    CPU *shadow = cache->shadow;
+    Memory *shadow_memory = (Memory *)(shadow + 1);
+    memcpy(shadow, cpu, sizeof(CPU));
+    memcpy(shadow_memory, cpu->memory, sizeof(Memory));
+    shadow->memory = shadow_memory;
+    rebase_bus(&shadow_memory->bus, (const uint8_t *)cpu->memory, (uint8_t *)shadow_memory,
+               MEMORY_REGIONS_SIZE);
+    shadow->block_cache = NULL;
+    if (cpu->mbc != NULL && !copy_mbc(cache, shadow, cpu)) {
+        block->native(cpu);
+        return;
+    }
+#ifdef FASTMEM
+    // The mirror maps the real memory, and bank switches of the copy must not remap it
+    shadow->fastmem = NULL;
+    shadow->fast_reads = 0;
+    shadow->fast_writes = 0;
+#endif
+
+    interpret_block(shadow, block);
+    block->native(cpu);
+
+    bool same = memcmp(&shadow->registers, &cpu->registers, sizeof(Registers)) == 0 &&
+                shadow->cycles == cpu->cycles && shadow->code_written == cpu->code_written &&
+                memcmp(shadow->memory, cpu->memory, MEMORY_REGIONS_SIZE) == 0 &&
+                (cpu->mbc == NULL || same_mbc(shadow->mbc, cpu->mbc));
+#ifdef LAZY_FLAGS
+    same = same && memcmp(&shadow->lazy_flags, &cpu->lazy_flags, sizeof(LazyFlags)) == 0;
+#endif
+    if (!same) {
+        fprintf(stderr, "dynarec: block at 0x%04X differs from the interpreter\n", block->start);
+        fprintf(stderr, "interpreter: pc=%04X af=%04X bc=%04X de=%04X hl=%04X sp=%04X\n",
+                shadow->registers.pc, shadow->registers.af, shadow->registers.bc,
+                shadow->registers.de, shadow->registers.hl, shadow->registers.sp);
+        fprintf(stderr, "dynarec:     pc=%04X af=%04X bc=%04X de=%04X hl=%04X sp=%04X\n",
+                cpu->registers.pc, cpu->registers.af, cpu->registers.bc, cpu->registers.de,
+                cpu->registers.hl, cpu->registers.sp);
+        abort();
+    }
+}
+#endif
+
+/* run_native runs a block through its compiled code,
+ * compiling it first once it is hot.
+ */
+void run_native(CPU *cpu, Block *block) {
+    if (block->native == NULL) {
+        if (block->no_native || ++block->hits < DYNAREC_HOT_HITS) {
+            interpret_block(cpu, block);
+            return;
+        }
+        compile_block(cpu, block);
+        if (block->native == NULL) {
+            interpret_block(cpu, block);
+            return;
+        }
+    }
+
+#ifdef DYNAREC_VERIFY
+    verify_native(cpu, block);
+#else
+    block->native(cpu);
+#endif
+}
+
+void free_dynarec(BlockCache *cache) {
+    if (cache->code != NULL) {
+        munmap(cache->code, DYNAREC_BUFFER_SIZE);
+        cache->code = NULL;
+    }
+    free(cache->shadow);
+    cache->shadow = NULL;
+    free(cache->shadow_ram);
+    cache->shadow_ram = NULL;
+    cache->shadow_ram_size = 0;
+}
+
+#endif
@@ -2,29 +2,25 @@
 
 #include "../../include/cpu.h"
 
-// TODO: decrease code repetition in arithmetic ops via indirection of code coming after res = ...
+/* The alu_* helpers implement an instruction on an operand that has already
+ * been fetched. They are shared by the register, (HL) and d8 variants of an
+ * instruction as well as by the per-opcode handlers in handlers.h, which
+ * fetch the operand straight from its register or address.
+ */
 
-void add(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
+void alu_add(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
     // This will wrap around i.e.
     // acc = 1111_1111 and val = 0000_0010
     // --> res = 0000_0001
     uint8_t res = acc + val;
+    record_flags(cpu, FLAG_OP_ADD, acc, val, 0, res);
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = (acc & HBYTE_M) + (val & HBYTE_M) > HBYTE_M;
-    bool carry = acc + val > BYTE_M;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    set_reg(cpu, A, res);
+    cpu->registers.a = res;
 }
 
-void add_hl(CPU *cpu, enum Operand source) {
-    uint16_t acc = get_reg(cpu, HL);
-    // val is one of the 16 bit regs: BC, DE, HL, SP
-    uint16_t val = get_reg(cpu, (enum RegisterName)source);
+void alu_add_hl(CPU *cpu, uint16_t val) {
+    uint16_t acc = cpu->registers.hl;
     uint16_t res = acc + val;
 
     bool zero = res == 0;
@@ -33,412 +29,193 @@ void add_hl(CPU *cpu, enum Operand source) {
     bool carry = acc + val > BBYTE_M;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, HL, res);
-}
-
-void add_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t res = acc + val;
-
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = (acc & HBYTE_M) + (val & HBYTE_M) > HBYTE_M;
-    bool carry = acc + val > BYTE_M;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    set_reg(cpu, A, res);
+    cpu->registers.hl = res;
 }
 
-void add_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
-    uint8_t res = acc + val;
-
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = (acc & HBYTE_M) + (val & HBYTE_M) > HBYTE_M;
-    bool carry = acc + val > BYTE_M;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_adc(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
+    uint8_t car = carry_flag(cpu);
+    uint8_t res = acc + val + car;
+    record_flags(cpu, FLAG_OP_ADD, acc, val, car, res);
 
-    set_reg(cpu, A, res);
+    cpu->registers.a = res;
 }
 
-void adc(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
-    uint8_t car = get_carry(&cpu->flag_reg);
-    uint8_t res = acc + val + car;
-
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = (acc & HBYTE_M) + (val & HBYTE_M) + (car & HBYTE_M) > HBYTE_M;
-    bool carry = acc + val + car > BYTE_M;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_sub(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
+    uint8_t res = acc - val;
+    record_flags(cpu, FLAG_OP_SUB, acc, val, 0, res);
 
-    set_reg(cpu, A, res);
+    cpu->registers.a = res;
 }
 
-void adc_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t car = get_carry(&cpu->flag_reg);
-    uint8_t res = acc + val + car;
-
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = (acc & HBYTE_M) + (val & HBYTE_M) + (car & HBYTE_M) > HBYTE_M;
-    bool carry = acc + val + car > BYTE_M;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_sbc(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
+    uint8_t car = carry_flag(cpu);
+    uint8_t res = acc - val - car;
+    record_flags(cpu, FLAG_OP_SUB, acc, val, car, res);
 
-    set_reg(cpu, A, res);
+    cpu->registers.a = res;
 }
 
-void adc_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
-    uint8_t car = get_carry(&cpu->flag_reg);
-    uint8_t res = acc + val + car;
-
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = (acc & HBYTE_M) + (val & HBYTE_M) + (car & HBYTE_M) > HBYTE_M;
-    bool carry = acc + val + car > BYTE_M;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_and(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
+    uint8_t res = acc && val;
+    record_flags(cpu, FLAG_OP_LOGIC, acc, val, 0, res);
 
-    set_reg(cpu, A, res);
+    cpu->registers.a = res;
 }
 
-void sub(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
-    uint8_t res = acc - val;
-
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M);
-    bool carry = acc < val;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_or(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
+    uint8_t res = acc || val;
+    record_flags(cpu, FLAG_OP_LOGIC, acc, val, 0, res);
 
-    set_reg(cpu, A, res);
+    cpu->registers.a = res;
 }
 
-void sub_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t res = acc - val;
-
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M);
-    bool carry = acc < val;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_xor(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
+    uint8_t res = acc ^ val;
+    record_flags(cpu, FLAG_OP_LOGIC, acc, val, 0, res);
 
-    set_reg(cpu, A, res);
+    cpu->registers.a = res;
 }
 
-void sub_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
+void alu_cp(CPU *cpu, uint8_t val) {
+    uint8_t acc = cpu->registers.a;
     uint8_t res = acc - val;
-
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M);
-    bool carry = acc < val;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    set_reg(cpu, A, res);
+    record_flags(cpu, FLAG_OP_SUB, acc, val, 0, res);
 }
 
-void sbc(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
-    uint8_t car = get_carry(&cpu->flag_reg);
-    uint8_t res = acc - val - car;
+// TODO: Look into zero if the values inside of the
+// registers are actually representations of signed integers
+uint8_t alu_inc(CPU *cpu, uint8_t val) {
+    uint8_t res = val + 1;
+    record_flags(cpu, FLAG_OP_INC, val, 1, carry_flag(cpu), res);
 
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M) + (car & HBYTE_M);
-    bool carry = acc < (val + car);
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    set_reg(cpu, A, res);
+    return res;
 }
 
-void sbc_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t car = get_carry(&cpu->flag_reg);
-    uint8_t res = acc - val - car;
+uint8_t alu_dec(CPU *cpu, uint8_t val) {
+    uint8_t res = val - 1;
+    record_flags(cpu, FLAG_OP_DEC, val, 1, carry_flag(cpu), res);
 
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M) + (car & HBYTE_M);
-    bool carry = acc < (val + car);
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    set_reg(cpu, A, res);
+    return res;
 }
 
-void sbc_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
-    uint8_t car = get_carry(&cpu->flag_reg);
-    uint8_t res = acc - val - car;
+/* Flag-free variants of the helpers above, for instructions whose flags
+ * are overwritten before anything reads them (see block_cache.c).
+ * CP and INC/DEC have nothing left but the result, so they have no helper.
+ */
+void alu_add_nf(CPU *cpu, uint8_t val) { cpu->registers.a += val; }
 
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M) + (car & HBYTE_M);
-    bool carry = acc < (val + car);
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_add_hl_nf(CPU *cpu, uint16_t val) { cpu->registers.hl += val; }
 
-    set_reg(cpu, A, res);
-}
+void alu_adc_nf(CPU *cpu, uint8_t val) { cpu->registers.a += val + carry_flag(cpu); }
 
-void and_(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
-    uint8_t res = acc && val;
+void alu_sub_nf(CPU *cpu, uint8_t val) { cpu->registers.a -= val; }
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    set_reg(cpu, A, res);
-}
+void alu_sbc_nf(CPU *cpu, uint8_t val) { cpu->registers.a -= val + carry_flag(cpu); }
 
-void and_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t res = acc && val;
-
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void alu_and_nf(CPU *cpu, uint8_t val) { cpu->registers.a = cpu->registers.a && val; }
 
-    set_reg(cpu, A, res);
-}
+void alu_or_nf(CPU *cpu, uint8_t val) { cpu->registers.a = cpu->registers.a || val; }
 
-void and_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
-    uint8_t res = acc && val;
+void alu_xor_nf(CPU *cpu, uint8_t val) { cpu->registers.a ^= val; }
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void add(CPU *cpu, enum Operand source) { alu_add(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-    set_reg(cpu, A, res);
+void add_hl(CPU *cpu, enum Operand source) {
+    // val is one of the 16 bit regs: BC, DE, HL, SP
+    alu_add_hl(cpu, get_reg(cpu, (enum RegisterName)source));
 }
 
-void or_(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
-    uint8_t res = acc || val;
-
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void add_ind(CPU *cpu) { alu_add(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-    set_reg(cpu, A, res);
-}
+void add_d8(CPU *cpu) { alu_add(cpu, read_byte(cpu)); }
 
-void or_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t res = acc || val;
+void adc(CPU *cpu, enum Operand source) { alu_adc(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void adc_ind(CPU *cpu) { alu_adc(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-    set_reg(cpu, A, res);
-}
+void adc_d8(CPU *cpu) { alu_adc(cpu, read_byte(cpu)); }
 
-void or_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
-    uint8_t res = acc || val;
+void sub(CPU *cpu, enum Operand source) { alu_sub(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void sub_ind(CPU *cpu) { alu_sub(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-    set_reg(cpu, A, res);
-}
+void sub_d8(CPU *cpu) { alu_sub(cpu, read_byte(cpu)); }
 
-void xor_(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
-    uint8_t res = acc ^ val;
+void sbc(CPU *cpu, enum Operand source) { alu_sbc(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void sbc_ind(CPU *cpu) { alu_sbc(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-    set_reg(cpu, A, res);
-}
+void sbc_d8(CPU *cpu) { alu_sbc(cpu, read_byte(cpu)); }
 
-void xor_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t res = acc ^ val;
+void and_(CPU *cpu, enum Operand source) { alu_and(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void and_ind(CPU *cpu) { alu_and(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-    set_reg(cpu, A, res);
-}
+void and_d8(CPU *cpu) { alu_and(cpu, read_byte(cpu)); }
 
-void xor_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
-    uint8_t res = acc ^ val;
+void or_(CPU *cpu, enum Operand source) { alu_or(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-    bool zero = res == 0;
-    bool subtract = false;
-    bool half_carry = true;
-    bool carry = false;
-    update_flags(cpu, zero, subtract, half_carry, carry);
+void or_ind(CPU *cpu) { alu_or(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-    set_reg(cpu, A, res);
-}
+void or_d8(CPU *cpu) { alu_or(cpu, read_byte(cpu)); }
 
-void cp(CPU *cpu, enum Operand source) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = get_reg(cpu, (enum RegisterName)source);
-    uint8_t res = acc - val;
+void xor_(CPU *cpu, enum Operand source) { alu_xor(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M);
-    bool carry = acc < val;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-}
+void xor_ind(CPU *cpu) { alu_xor(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-void cp_ind(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint8_t res = acc - val;
+void xor_d8(CPU *cpu) { alu_xor(cpu, read_byte(cpu)); }
 
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M);
-    bool carry = acc < val;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-}
+void cp(CPU *cpu, enum Operand source) { alu_cp(cpu, get_reg(cpu, (enum RegisterName)source)); }
 
-void cp_d8(CPU *cpu) {
-    uint8_t acc = get_reg(cpu, A);
-    uint8_t val = read_byte(cpu);
-    uint8_t res = acc - val;
+void cp_ind(CPU *cpu) { alu_cp(cpu, mem_read(cpu, get_reg(cpu, HL))); }
 
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (acc & HBYTE_M) < (val & HBYTE_M);
-    bool carry = acc < val;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-}
+void cp_d8(CPU *cpu) { alu_cp(cpu, read_byte(cpu)); }
 
 void inc(CPU *cpu, enum Operand target) {
     uint16_t val = get_reg(cpu, (enum RegisterName)target);
-    uint16_t res = val + 1;
 
     // Flags are only affected when incrementing
     // a byte register as opposed to a 2-byte register.
-    // TODO: Look into zero if the values inside of the
-    // registers are actually representations of signed integers
-    if (target < O_AF) {
-        bool zero = false;
-        bool subtract = false;
-        bool half_carry = (val & HBYTE_M) + 1 > HBYTE_M;
-        bool carry = cpu->flag_reg.carry;
-        update_flags(cpu, zero, subtract, half_carry, carry);
-    }
+    uint16_t res = target < O_AF ? alu_inc(cpu, val) : val + 1;
 
     set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
 }
 
 void inc_ind(CPU *cpu) {
     uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint16_t res = val + 1;
-
-    bool zero = false;
-    bool subtract = false;
-    bool half_carry = (val & HBYTE_M) + 1 > HBYTE_M;
-    bool carry = cpu->flag_reg.carry;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    cpu->memory[addr] = res;
+    mem_write(cpu, addr, alu_inc(cpu, mem_read(cpu, addr)));
 }
 
 void dec(CPU *cpu, enum Operand target) {
     uint16_t val = get_reg(cpu, (enum RegisterName)target);
-    uint16_t res = val - 1;
-
-    // TODO: same as above
-    if (target < O_AF) {
-        bool zero = res == 0;
-        bool subtract = true;
-        bool half_carry = (val & HBYTE_M) >= 1;
-        bool carry = cpu->flag_reg.carry;
-        update_flags(cpu, zero, subtract, half_carry, carry);
-    }
+
+    // Same as above
+    uint16_t res = target < O_AF ? alu_dec(cpu, val) : val - 1;
 
     set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
 }
 
 void dec_ind(CPU *cpu) {
     uint16_t addr = get_reg(cpu, HL);
-    uint8_t val = cpu->memory[addr];
-    uint16_t res = val - 1;
-
-    bool zero = res == 0;
-    bool subtract = true;
-    bool half_carry = (val & HBYTE_M) >= 1;
-    bool carry = cpu->flag_reg.carry;
-    update_flags(cpu, zero, subtract, half_carry, carry);
-
-    cpu->memory[addr] = res;
+    mem_write(cpu, addr, alu_dec(cpu, mem_read(cpu, addr)));
 }
 
 void ccf(CPU *cpu) {
-    bool zero = cpu->flag_reg.zero;
+    bool zero = zero_flag(cpu);
     bool subtract = false;
     bool half_carry = false;
-    bool carry = !cpu->flag_reg.carry;
+    bool carry = !carry_flag(cpu);
     update_flags(cpu, zero, subtract, half_carry, carry);
 }
 
 void scf(CPU *cpu) {
-    bool zero = cpu->flag_reg.zero;
+    bool zero = zero_flag(cpu);
     bool subtract = false;
     bool half_carry = false;
     bool carry = true;
@@ -457,7 +234,7 @@ void scf(CPU *cpu) {
 void rra(CPU *cpu) {
     uint8_t acc = get_reg(cpu, A);
     uint8_t lsb = acc & 1;
-    uint8_t car = get_carry(&cpu->flag_reg);
+    uint8_t car = carry_flag(cpu);
     uint8_t res = car << MSB_IDX | acc >> 1;
 
     bool zero = res == 0;
@@ -481,7 +258,7 @@ void rra(CPU *cpu) {
 void rla(CPU *cpu) {
     uint8_t acc = get_reg(cpu, A);
     uint8_t msb = (acc >> MSB_IDX) & 1;
-    uint8_t car = get_carry(&cpu->flag_reg);
+    uint8_t car = carry_flag(cpu);
     uint8_t res = acc << 1 | car;
 
     bool zero = res == 0;
@@ -541,59 +318,26 @@ void cpl(CPU *cpu) {
     uint8_t acc = get_reg(cpu, A);
     uint8_t res = ~acc;
 
-    bool zero = cpu->flag_reg.zero;
+    bool zero = zero_flag(cpu);
     bool subtract = true;
     bool half_carry = true;
-    bool carry = cpu->flag_reg.carry;
+    bool carry = carry_flag(cpu);
     update_flags(cpu, zero, subtract, half_carry, carry);
 
     set_reg(cpu, A, res);
 }
 
-void bit(CPU *cpu, uint8_t bit_index, enum Operand target) {  // NOLINT
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+void alu_bit(CPU *cpu, uint8_t bit_index, uint8_t val) {
     uint8_t bit = (val >> bit_index) & 1;
 
     bool zero = bit == 0;
     bool subtract = false;
     bool half_carry = true;
-    bool carry = cpu->flag_reg.carry;
+    bool carry = carry_flag(cpu);
     update_flags(cpu, zero, subtract, half_carry, carry);
 }
 
-/* Reset bit at bit_index to 0
- * For example, to reset b6:
- *
- * b7 b6 b5 b4 b3 b2 b1 b0
- *
- * &
- *
- * 1  0  1  1  1  1  1  1
- * */
-void reset(CPU *cpu, uint8_t bit_index, enum Operand target) {  // NOLINT
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
-    uint8_t res = val & ~(1 << bit_index);
-
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
-}
-
-/* Set bit at bit_index to 1
- * For example, to set b6:
- *
- * b7 b6 b5 b4 b3 b2 b1 b0
- *
- * |
- *
- * 0  1  0  0  0  0  0  0
- * */
-void set(CPU *cpu, uint8_t bit_index, enum Operand target) {  // NOLINT
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
-    uint8_t res = val | (1 << bit_index);
-
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
-}
-
-/* Shift target right into carry
+/* Shift val right into carry
  * - lsb becomes new carry
  * - msb becomes 0
  * - the rest of the bits are right shifted
@@ -602,8 +346,7 @@ void set(CPU *cpu, uint8_t bit_index, enum Operand target) {  // NOLINT
  *
  * b0  0 b7 b6 b5 b4 b3 b2 b1
  */
-void srl(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_srl(CPU *cpu, uint8_t val) {
     uint8_t lsb = val & 1;
     uint8_t res = val >> 1;
 
@@ -613,10 +356,10 @@ void srl(CPU *cpu, enum Operand target) {
     bool carry = lsb == 1;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+    return res;
 }
 
-/* Rotate target right through carry
+/* Rotate val right through carry
  * - lsb becomes new carry
  * - carry becomes new msb
  * - the rest of the bits are right shifted
@@ -625,10 +368,9 @@ void srl(CPU *cpu, enum Operand target) {
  *
  * b0  c b7 b6 b5 b4 b3 b2 b1
  */
-void rr(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_rr(CPU *cpu, uint8_t val) {
     uint8_t lsb = val & 1;
-    uint8_t car = get_carry(&cpu->flag_reg);
+    uint8_t car = carry_flag(cpu);
     uint8_t res = car << MSB_IDX | val >> 1;
 
     bool zero = res == 0;
@@ -637,10 +379,10 @@ void rr(CPU *cpu, enum Operand target) {
     bool carry = lsb == 1;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+    return res;
 }
 
-/* Rotate target left through carry
+/* Rotate val left through carry
  * - msb becomes new carry
  * - carry becomes new lsb
  * - the rest of the bits are left shifted
@@ -649,10 +391,9 @@ void rr(CPU *cpu, enum Operand target) {
  *
  * b7  b6 b5 b4 b3 b2 b1 b0 c
  */
-void rl(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_rl(CPU *cpu, uint8_t val) {
     uint8_t msb = (val >> MSB_IDX) & 1;
-    uint8_t car = get_carry(&cpu->flag_reg);
+    uint8_t car = carry_flag(cpu);
     uint8_t res = val << 1 | car;
 
     bool zero = res == 0;
@@ -661,10 +402,10 @@ void rl(CPU *cpu, enum Operand target) {
     bool carry = msb == 1;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+    return res;
 }
 
-/* Rotate target right and set carry to lsb
+/* Rotate val right and set carry to lsb
  * - lsb becomes new carry
  * - the rest of the bits are right shifted
  *
@@ -672,8 +413,7 @@ void rl(CPU *cpu, enum Operand target) {
  *
  * b0  b0 b7 b6 b5 b4 b3 b2 b1
  */
-void rrc(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_rrc(CPU *cpu, uint8_t val) {
     uint8_t lsb = val & 1;
     uint8_t res = (lsb << MSB_IDX) | val >> 1;
 
@@ -683,10 +423,10 @@ void rrc(CPU *cpu, enum Operand target) {
     bool carry = lsb == 1;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+    return res;
 }
 
-/* Rotate A left and set carry to msb
+/* Rotate val left and set carry to msb
  * - msb becomes new carry
  * - the rest of the bits are left shifted
  *
@@ -694,8 +434,7 @@ void rrc(CPU *cpu, enum Operand target) {
  *
  * b7  b6 b5 b4 b3 b2 b1 b0 b7
  */
-void rlc(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_rlc(CPU *cpu, uint8_t val) {
     uint8_t msb = (val >> MSB_IDX) & 1;
     uint8_t res = val << 1 | msb;
 
@@ -705,10 +444,10 @@ void rlc(CPU *cpu, enum Operand target) {
     bool carry = msb == 1;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+    return res;
 }
 
-/* Shift target right into carry (also sign extend)
+/* Shift val right into carry (also sign extend)
  * - lsb becomes new carry
  * - msb is duplicated
  * - bits are right shifted
@@ -717,8 +456,7 @@ void rlc(CPU *cpu, enum Operand target) {
  *
  * b0 b7 b7 b6 b5 b4 b3 b2 b1
  */
-void sra(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_sra(CPU *cpu, uint8_t val) {
     uint8_t lsb = val & 1;
     uint8_t msb = (val >> MSB_IDX) & 1;
     uint8_t res = msb << MSB_IDX | val >> 1;
@@ -729,18 +467,17 @@ void sra(CPU *cpu, enum Operand target) {
     bool carry = lsb == 1;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+    return res;
 }
 
-/* Shift target left into carry
+/* Shift val left into carry
  * - msb becomes new carry
  *
  * c  b7 b6 b5 b4 b3 b2 b1 b0
  *
  * b7 b6 b5 b4 b3 b2 b1 b0 0
  */
-void sla(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_sla(CPU *cpu, uint8_t val) {
     uint8_t msb = (val >> MSB_IDX) & 1;
     uint8_t res = val << 1;
 
@@ -750,11 +487,10 @@ void sla(CPU *cpu, enum Operand target) {
     bool carry = msb == 1;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
-    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+    return res;
 }
 
-void swap(CPU *cpu, enum Operand target) {
-    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+uint8_t alu_swap(CPU *cpu, uint8_t val) {
     uint8_t lower_nibble = val & HBYTE_M;
     uint8_t upper_nibble = (val >> 4) & HBYTE_M;
     uint8_t res = lower_nibble << 4 | upper_nibble;
@@ -765,6 +501,82 @@ void swap(CPU *cpu, enum Operand target) {
     bool carry = false;
     update_flags(cpu, zero, subtract, half_carry, carry);
 
+    return res;
+}
+
+void bit(CPU *cpu, uint8_t bit_index, enum Operand target) {  // NOLINT
+    alu_bit(cpu, bit_index, get_reg(cpu, (enum RegisterName)target));
+}
+
+/* Reset bit at bit_index to 0
+ * For example, to reset b6:
+ *
+ * b7 b6 b5 b4 b3 b2 b1 b0
+ *
+ * &
+ *
+ * 1  0  1  1  1  1  1  1
+ * */
+void reset(CPU *cpu, uint8_t bit_index, enum Operand target) {  // NOLINT
+    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+    uint8_t res = val & ~(1 << bit_index);
+
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+/* Set bit at bit_index to 1
+ * For example, to set b6:
+ *
+ * b7 b6 b5 b4 b3 b2 b1 b0
+ *
+ * |
+ *
+ * 0  1  0  0  0  0  0  0
+ * */
+void set(CPU *cpu, uint8_t bit_index, enum Operand target) {  // NOLINT
+    uint8_t val = get_reg(cpu, (enum RegisterName)target);
+    uint8_t res = val | (1 << bit_index);
+
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void srl(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_srl(cpu, get_reg(cpu, (enum RegisterName)target));
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void rr(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_rr(cpu, get_reg(cpu, (enum RegisterName)target));
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void rl(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_rl(cpu, get_reg(cpu, (enum RegisterName)target));
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void rrc(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_rrc(cpu, get_reg(cpu, (enum RegisterName)target));
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void rlc(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_rlc(cpu, get_reg(cpu, (enum RegisterName)target));
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void sra(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_sra(cpu, get_reg(cpu, (enum RegisterName)target));
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void sla(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_sla(cpu, get_reg(cpu, (enum RegisterName)target));
+    set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
+}
+
+void swap(CPU *cpu, enum Operand target) {
+    uint8_t res = alu_swap(cpu, get_reg(cpu, (enum RegisterName)target));
     set_reg(cpu, (enum RegisterName)target, res);  // NOLINT
 }
 
@@ -772,22 +584,22 @@ bool jump_test(const CPU *cpu, enum JumpCondition jump_cond) {
     bool jump = false;
     switch (jump_cond) {
         case NOT_ZERO:
-            if (!cpu->flag_reg.zero) {
+            if (!zero_flag(cpu)) {
                 jump = true;
             }
             break;
         case ZERO:
-            if (cpu->flag_reg.zero) {
+            if (zero_flag(cpu)) {
                 jump = true;
             }
             break;
         case NOT_CARRY:
-            if (!cpu->flag_reg.carry) {
+            if (!carry_flag(cpu)) {
                 jump = true;
             }
             break;
         case CARRY:
-            if (cpu->flag_reg.carry) {
+            if (carry_flag(cpu)) {
                 jump = true;
             }
             break;
@@ -803,13 +615,19 @@ bool jump_test(const CPU *cpu, enum JumpCondition jump_cond) {
  * If the jump condition is not true, we simply increment
  * the program counter by the size of the instruction.
  * (1 byte for the instr + 2 bytes for the address)
+ *
+ * The cycle tables only cover a conditional jump that is not taken,
+ * so taking it adds the extra cycles here.
  */
 uint16_t jp(CPU *cpu, enum JumpCondition jump_cond) {
     uint16_t addr = read_bbyte(cpu);
-    uint16_t next_pc = cpu->prog_count + 3;
+    uint16_t next_pc = cpu->registers.pc + 3;
 
     bool jump = jump_test(cpu, jump_cond);
     if (jump) {
+        if (jump_cond != ALWAYS) {
+            cpu->cycles += JP_TAKEN_CYCLES;
+        }
         return addr;
     }
 
@@ -827,10 +645,13 @@ uint16_t jr(CPU *cpu, enum JumpCondition jump_cond) {
 
     bool jump = jump_test(cpu, jump_cond);
     if (jump) {
-        return cpu->prog_count + offset_signed;
+        if (jump_cond != ALWAYS) {
+            cpu->cycles += JR_TAKEN_CYCLES;
+        }
+        return cpu->registers.pc + offset_signed;
     }
 
-    return cpu->prog_count + 2;
+    return cpu->registers.pc + 2;
 }
 
 void ld_reg(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
@@ -839,7 +660,7 @@ void ld_reg(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
 }
 
 void ld_d8(CPU *cpu, enum Operand target) {
-    uint8_t res = cpu->memory[cpu->prog_count + 1];
+    uint8_t res = mem_read(cpu, cpu->registers.pc + 1);
     set_reg(cpu, (enum RegisterName)target, res);
 }
 
@@ -851,7 +672,7 @@ void ld_d16(CPU *cpu, enum Operand target) {
 void ld_d8_ind(CPU *cpu) {
     uint8_t res = read_byte(cpu);
     uint16_t addr = get_reg(cpu, HL);
-    cpu->memory[addr] = res;
+    mem_write(cpu, addr, res);
 }
 
 void ld_ind(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
@@ -866,7 +687,7 @@ void ld_ind(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
             addr_reg = HL;
         }
         uint16_t addr = get_reg(cpu, addr_reg);
-        uint8_t res = cpu->memory[addr];
+        uint8_t res = mem_read(cpu, addr);
 
         set_reg(cpu, (enum RegisterName)target, res);
     }
@@ -884,7 +705,7 @@ void ld_ind(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
         uint16_t addr = get_reg(cpu, addr_reg);
         uint8_t res = get_reg(cpu, (enum RegisterName)source);  // NOLINT
 
-        cpu->memory[addr] = res;
+        mem_write(cpu, addr, res);
     }
 }
 
@@ -892,7 +713,7 @@ void ld_addr(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     /* Load from address into register */
     if (source == O_A16_IND) {
         uint16_t addr = read_bbyte(cpu);
-        uint8_t res = cpu->memory[addr];
+        uint8_t res = mem_read(cpu, addr);
         set_reg(cpu, (enum RegisterName)target, res);
     }
 
@@ -900,7 +721,7 @@ void ld_addr(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     else if (target == O_A16_IND) {
         uint16_t addr = read_bbyte(cpu);
         uint8_t res = get_reg(cpu, (enum RegisterName)source);
-        cpu->memory[addr] = res;
+        mem_write(cpu, addr, res);
     }
 }
 
@@ -908,7 +729,7 @@ void ld_inc(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     /* Load from address into register */
     if (source == O_HL_INC_IND) {
         uint16_t addr = get_reg(cpu, HL);
-        uint8_t res = cpu->memory[addr];
+        uint8_t res = mem_read(cpu, addr);
         set_reg(cpu, (enum RegisterName)target, res);
         set_reg(cpu, HL, addr + 1);
     }
@@ -917,7 +738,7 @@ void ld_inc(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     else if (target == O_HL_INC_IND) {
         uint16_t addr = get_reg(cpu, HL);
         uint8_t res = get_reg(cpu, (enum RegisterName)source);
-        cpu->memory[addr] = res;
+        mem_write(cpu, addr, res);
         set_reg(cpu, HL, addr + 1);
     }
 }
@@ -926,7 +747,7 @@ void ld_dec(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     /* Load from address into register */
     if (source == O_HL_DEC_IND) {
         uint16_t addr = get_reg(cpu, HL);
-        uint8_t res = cpu->memory[addr];
+        uint8_t res = mem_read(cpu, addr);
         set_reg(cpu, (enum RegisterName)target, res);
         set_reg(cpu, HL, addr - 1);
     }
@@ -935,7 +756,7 @@ void ld_dec(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     else if (target == O_HL_DEC_IND) {
         uint16_t addr = get_reg(cpu, HL);
         uint8_t res = get_reg(cpu, (enum RegisterName)source);
-        cpu->memory[addr] = res;
+        mem_write(cpu, addr, res);
         set_reg(cpu, HL, addr - 1);
     }
 }
@@ -945,7 +766,7 @@ void ldh_ind(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     if (source == O_C_IND) {
         uint8_t lower_addr = get_reg(cpu, C);
         uint16_t addr = UPPER_BYTE_M | lower_addr;
-        uint8_t res = cpu->memory[addr];
+        uint8_t res = mem_read(cpu, addr);
         set_reg(cpu, (enum RegisterName)target, res);
     }
 
@@ -954,7 +775,7 @@ void ldh_ind(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
         uint8_t lower_addr = get_reg(cpu, C);
         uint16_t addr = UPPER_BYTE_M | lower_addr;
         uint8_t res = get_reg(cpu, (enum RegisterName)source);
-        cpu->memory[addr] = res;
+        mem_write(cpu, addr, res);
     }
 }
 
@@ -963,7 +784,7 @@ void ldh_addr(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
     if (source == O_A8_IND) {
         uint8_t lower_addr = read_byte(cpu);
         uint16_t addr = UPPER_BYTE_M | lower_addr;
-        uint8_t res = cpu->memory[addr];
+        uint8_t res = mem_read(cpu, addr);
         set_reg(cpu, (enum RegisterName)target, res);
     }
 
@@ -972,7 +793,7 @@ void ldh_addr(CPU *cpu, enum Operand target, enum Operand source) {  // NOLINT
         uint8_t lower_addr = read_byte(cpu);
         uint16_t addr = UPPER_BYTE_M | lower_addr;
         uint8_t res = get_reg(cpu, (enum RegisterName)source);
-        cpu->memory[addr] = res;
+        mem_write(cpu, addr, res);
     }
 }
 
@@ -983,21 +804,17 @@ void push(CPU *cpu, enum Operand source) {
 
 void pop(CPU *cpu, enum Operand target) {
     uint16_t val = stack_pop(cpu);
-
-    /* Update flag register with F when popping AF */
-    if (target == O_AF) {
-        uint8_t val_lower = BYTE_M & val;
-        cpu->flag_reg = byte_to_flag_reg(val_lower);
-    }
-
     set_reg(cpu, (enum RegisterName)target, val);
 }
 
 uint16_t call(CPU *cpu, enum JumpCondition jump_cond) {
-    uint16_t next_pc = cpu->prog_count + 3;
+    uint16_t next_pc = cpu->registers.pc + 3;
 
     bool jump = jump_test(cpu, jump_cond);
     if (jump) {
+        if (jump_cond != ALWAYS) {
+            cpu->cycles += CALL_TAKEN_CYCLES;
+        }
         stack_push(cpu, next_pc);
         uint16_t addr = read_bbyte(cpu);
         return addr;
@@ -1007,12 +824,69 @@ uint16_t call(CPU *cpu, enum JumpCondition jump_cond) {
 }
 
 uint16_t ret(CPU *cpu, enum JumpCondition jump_cond) {
-    uint16_t next_pc = cpu->prog_count + 1;
+    uint16_t next_pc = cpu->registers.pc + 1;
 
     bool jump = jump_test(cpu, jump_cond);
     if (jump) {
+        if (jump_cond != ALWAYS) {
+            cpu->cycles += RET_TAKEN_CYCLES;
+        }
         return stack_pop(cpu);
     }
 
     return next_pc;
 }
+
+uint16_t reti(CPU *cpu) {
+    cpu->ime = true;
+    update_interrupts(cpu);
+    return stack_pop(cpu);
+}
+
+uint16_t rst(CPU *cpu, uint8_t vector) {
+    stack_push(cpu, cpu->registers.pc + 1);
+    return vector;
+}
+
+void di(CPU *cpu) {
+    cpu->ime = false;
+    cpu->ei_delay = false;
+}
+
+/* IME is only set once the next instruction is done, see finish_ei() */
+void ei(CPU *cpu) {
+    cpu->ei_delay = true;
+    lower_limit(cpu, cpu->cycles);
+}
+
+/* A halted CPU keeps executing HALT until an interrupt is pending, whether
+ * or not IME lets it be taken. With IME set, the interrupt is dispatched
+ * with the address following HALT as its return address.
+ *
+ * Nothing but an event or the end of the run can change that, so HALT skips
+ * straight to cpu->limit. It skips whole HALTs of 4 cycles, so it wakes up
+ * at the same cycle as it would executing HALT over and over.
+ */
+uint16_t halt(CPU *cpu) {
+    uint8_t length = inst_lengths[mem_read(cpu, cpu->registers.pc)];
+    if (interrupt_pending(cpu)) {
+        cpu->halted = false;
+        return cpu->registers.pc + length;
+    }
+    cpu->halted = true;
+    if (cpu->cycles < cpu->limit) {
+        uint64_t halts = (cpu->limit - cpu->cycles + HALT_CYCLES - 1) / HALT_CYCLES;
+        cpu->cycles += halts * HALT_CYCLES;
+    }
+    return cpu->registers.pc;
+}
+
+/* Nothing but the joypad wakes up a stopped CPU on hardware. There is no
+ * joypad yet, so STOP waits for any interrupt like HALT does.
+ */
+uint16_t stop(CPU *cpu) {
+    if (!cpu->halted) {
+        write_timer(cpu, IO_DIV, 0);
+    }
+    return halt(cpu);
+}
@@ -0,0 +1,142 @@
+// mmap() is POSIX and mremap() is Linux, neither is part of C11
+#define _GNU_SOURCE
+
+#include "../../include/cpu.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define FASTMEM_SIZE (FASTMEM_WINDOWS * FASTMEM_WINDOW)
+#define WINDOW_PAGES (FASTMEM_WINDOW / PAGE_SIZE)
+
+/* alloc_memory returns size zeroed bytes for the bus to map, or NULL.
+ * With FASTMEM they are a shared mapping, which fastmem windows can map
+ * a second time.
+ */
+void *alloc_memory(size_t size) {
+#ifdef FASTMEM
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return memory != MAP_FAILED ? memory : NULL;
+#else
+    return calloc(1, size);
+#endif
+}
+
+void free_memory(void *memory, size_t size) {
+#ifdef FASTMEM
+    if (memory != NULL) {
+        munmap(memory, size);
+    }
+#else
+    (void)size;
+    free(memory);
+#endif
+}
+
+#ifdef FASTMEM
+
+/* init_fastmem reserves the mirror of the address space. Without it,
+ * or on hosts whose pages aren't FASTMEM_WINDOW bytes, everything
+ * just goes through the bus.
+ */
+void init_fastmem(CPU *cpu) {
+    cpu->fastmem = NULL;
+    cpu->fast_reads = 0;
+    cpu->fast_writes = 0;
+    if (sysconf(_SC_PAGESIZE) != FASTMEM_WINDOW) {
+        return;
+    }
+
+    // Reserve twice the size and cut it down to the aligned half
+    uint8_t *region = mmap(NULL, 2 * FASTMEM_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return;
+    }
+    uintptr_t offset = -(uintptr_t)region & (FASTMEM_SIZE - 1);
+    if (offset > 0) {
+        munmap(region, offset);
+    }
+    munmap(region + offset + FASTMEM_SIZE, FASTMEM_SIZE - offset);
+    cpu->fastmem = region + offset;
+    forget_fastmem(cpu);
+}
+
+/* The memory a window of pages points at, if it is one aligned host page */
+static const uint8_t *window_memory(const uint8_t *const *pages) {
+    const uint8_t *memory = pages[0];
+    if (memory == NULL || (uintptr_t)memory & (FASTMEM_WINDOW - 1)) {
+        return NULL;
+    }
+    for (int page = 1; page < WINDOW_PAGES; page++) {
+        if (pages[page] != memory + page * PAGE_SIZE) {
+            return NULL;
+        }
+    }
+    return memory;
+}
+
+/* sync_fastmem maps the windows covering count pages from page to what
+ * the bus maps there now, or hands them back to the bus if it can't.
+ * mremap() with an old size of 0 maps the pages of a shared mapping a
+ * second time, so the mirror and the bus always see the same memory.
+ */
+void sync_fastmem(CPU *cpu, uint8_t page, uint16_t count) {
+    if (cpu->fastmem == NULL || count == 0) {
+        return;
+    }
+
+    int last = (page + count - 1 < PAGE_COUNT ? page + count - 1 : PAGE_COUNT - 1) / WINDOW_PAGES;
+    for (int window = page / WINDOW_PAGES; window <= last; window++) {
+        uint16_t bit = 1 << window;
+        const uint8_t *read = window_memory(cpu->memory->bus.read_pages + window * WINDOW_PAGES);
+        const uint8_t *write = window_memory((const uint8_t *const *)cpu->memory->bus.write_pages +
+                                             window * WINDOW_PAGES);
+        cpu->fast_reads &= ~bit;
+        cpu->fast_writes &= ~bit;
+        if (read == NULL) {
+            continue;
+        }
+
+        // Bank switches often map the same memory again
+        if (read != cpu->fast_sources[window]) {
+            uint8_t *target = cpu->fastmem + window * FASTMEM_WINDOW;
+            void *mirror = mremap((void *)read, 0, FASTMEM_WINDOW, MREMAP_MAYMOVE | MREMAP_FIXED,
+                                  target);
+            // Private mappings such as plain heap memory can't be mirrored
+            if (mirror == MAP_FAILED) {
+                cpu->fast_sources[window] = NULL;
+                mmap(target, FASTMEM_WINDOW, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                     -1, 0);
+                continue;
+            }
+            cpu->fast_sources[window] = read;
+        }
+        cpu->fast_reads |= bit;
+        if (write == read) {
+            cpu->fast_writes |= bit;
+        }
+    }
+}
+
+/* forget_fastmem makes the next sync map every window again, for when
+ * memory the mirror may still map is freed and its address can come back.
+ */
+void forget_fastmem(CPU *cpu) {
+    for (int window = 0; window < FASTMEM_WINDOWS; window++) {
+        cpu->fast_sources[window] = NULL;
+    }
+}
+
+void free_fastmem(CPU *cpu) {
+    if (cpu->fastmem == NULL) {
+        return;
+    }
+    munmap(cpu->fastmem, FASTMEM_SIZE);
+    cpu->fastmem = NULL;
+    cpu->fast_reads = 0;
+    cpu->fast_writes = 0;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#include "../../include/handlers.h"
+
+#include <stdint.h>
+
+/* Opcodes outside of the opcode map fall back to their decoded Instruction */
+static uint16_t op_unknown(CPU *cpu) {
+    return execute(cpu, &inst_table[mem_read(cpu, cpu->registers.pc)]);
+}
+
+static uint16_t op_prefix(CPU *cpu) {
+    uint8_t pf_byte = mem_read(cpu, cpu->registers.pc + 1);
+    cpu->cycles += pf_inst_cycles[pf_byte];
+    return pf_op_handlers[pf_byte](cpu);
+}
+
+#define HANDLER_ENTRY(opcode, kind, bit_index, jump_cond, target, source) [opcode] = op_##opcode,
+#define PF_HANDLER_ENTRY(opcode, kind, bit_index, jump_cond, target, source) \
+    [opcode] = pf_op_##opcode,
+#define NF_HANDLER_ENTRY(opcode, kind, bit_index, jump_cond, target, source) \
+    [opcode] = nf_op_##opcode,
+
+// Every slot starts out as op_unknown and is then overridden by the opcode map
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+__extension__ const OpHandler op_handlers[OPCODE_COUNT] = {
+    [0 ... OPCODE_COUNT - 1] = op_unknown,
+    [PREFIX_BYTE] = op_prefix,
+    BASE_OPCODES(HANDLER_ENTRY)  // NOLINT
+};
+#pragma GCC diagnostic pop
+
+const OpHandler pf_op_handlers[OPCODE_COUNT] = {PREFIX_OPCODES(PF_HANDLER_ENTRY)};
+
+const OpHandler nf_op_handlers[OPCODE_COUNT] = {ALU_OPCODES(NF_HANDLER_ENTRY)};
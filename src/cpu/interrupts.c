@@ -0,0 +1,58 @@
+#include "../../include/cpu.h"
+
+#include <stdint.h>
+
+void request_interrupt(CPU *cpu, uint8_t interrupt) {
+    cpu->memory->high[IO_IF & BYTE_M] |= interrupt;
+    update_interrupts(cpu);
+}
+
+/* update_interrupts stops the running CPU after the current instruction
+ * if an interrupt can be taken, called whenever IME, IE or IF change.
+ * A halted CPU with IME clear doesn't need it, HALT wakes up by itself.
+ */
+void update_interrupts(CPU *cpu) {
+    if (cpu->ime && interrupt_pending(cpu)) {
+        lower_limit(cpu, cpu->cycles);
+    }
+}
+
+/* handle_interrupts wakes up a halted CPU and, if IME is set, dispatches
+ * the pending interrupt with the lowest bit. Returns whether it did.
+ */
+bool handle_interrupts(CPU *cpu) {
+    if (!interrupt_pending(cpu)) {
+        return false;
+    }
+    if (cpu->halted) {
+        cpu->halted = false;
+        cpu->registers.pc += inst_lengths[mem_read(cpu, cpu->registers.pc)];
+    }
+    if (!cpu->ime) {
+        return false;
+    }
+
+    uint8_t *flags = &cpu->memory->high[IO_IF & BYTE_M];
+    uint8_t pending = cpu->memory->high[IO_IE & BYTE_M] & *flags & INT_M;
+    uint8_t index = 0;
+    while (!(pending >> index & 1)) {
+        index++;
+    }
+
+    *flags &= ~(1 << index);
+    cpu->ime = false;
+    cpu->cycles += INT_DISPATCH_CYCLES;
+    stack_push(cpu, cpu->registers.pc);
+    cpu->registers.pc = INT_VECTORS + index * INT_VECTOR_SIZE;
+    return true;
+}
+
+/* finish_ei is called after the instruction following EI, which sets IME
+ * unless a DI in between took it back.
+ */
+void finish_ei(CPU *cpu) {
+    if (cpu->ei_delay) {
+        cpu->ei_delay = false;
+        cpu->ime = true;
+    }
+}
@@ -0,0 +1,392 @@
+// mmap() and msync() are POSIX and not part of C11
+#define _DEFAULT_SOURCE
+
+#include "../../include/cpu.h"
+// cpu.h has to come first
+#include "../../include/cartridge.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RAM_ENABLE_M 0x0F
+#define RAM_ENABLE 0x0A
+#define MBC1_BANK_LOW_M 0x1F
+#define MBC1_BANK_HIGH_M 0x03
+#define MBC1_BANK_HIGH_SHIFT 5
+#define MBC2_BANK_M 0x0F
+#define MBC2_REGISTER_BIT 0x0100 /*Address bit that selects the ROM bank register*/
+#define MBC2_CELL_M 0x0F
+#define MBC3_BANK_M 0x7F
+#define MBC5_BANK_HIGH_M 0x01
+#define MBC5_RAM_BANK_M 0x0F
+
+/* MBC register ranges, each covers 0x2000 bytes of ROM */
+#define REG_RAM_ENABLE 0x0000
+#define REG_ROM_BANK 0x2000
+#define REG_RAM_BANK 0x4000
+#define REG_MODE 0x6000
+#define MBC5_REG_BANK_HIGH 0x3000
+
+#define ROM_BANK_PAGES (ROM_BANK_SIZE / PAGE_SIZE)
+
+/* The code following a bank switch may now come from another bank,
+ * so the running block is left like after a write to its code.
+ */
+static void map_rom(CPU *cpu) {
+    const Mbc *mbc = cpu->mbc;
+    const uint8_t *rom = mbc->cart->rom;
+    map_pages(cpu, ROM_START >> BYTE_SIZE, ROM_BANK_PAGES, rom + mbc->rom_bank0 * ROM_BANK_SIZE,
+              NULL);
+    map_pages(cpu, (ROM_START >> BYTE_SIZE) + ROM_BANK_PAGES, ROM_BANK_PAGES,
+              rom + mbc->rom_bank * ROM_BANK_SIZE, NULL);
+#ifdef BLOCK_DISPATCH
+    cpu->code_written = true;
+#endif
+}
+
+/* The first write to a clean page of a save file marks it dirty and
+ * maps it, so later writes to it go straight to memory until the next flush.
+ */
+static void save_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    Mbc *mbc = cpu->mbc;
+    uint32_t offset = mbc->ram_select * RAM_BANK_SIZE + (addr - SRAM_START);
+    uint8_t *page = mbc->ram + (offset & ~(PAGE_SIZE - 1));
+    mbc->dirty[offset / PAGE_SIZE] = true;
+    map_pages(cpu, addr >> BYTE_SIZE, 1, page, page);
+    mem_write(cpu, addr, val);
+}
+
+/* Disabled RAM and bank registers without RAM or clock registers
+ * behind them read as open bus.
+ */
+static void map_ram(CPU *cpu) {
+    Mbc *mbc = cpu->mbc;
+    if (mbc->ram_enabled && mbc->ram_select < mbc->cart->ram_banks) {
+        uint8_t *bank = mbc->ram + mbc->ram_select * RAM_BANK_SIZE;
+        map_pages(cpu, SRAM_START >> BYTE_SIZE, SRAM_SIZE / PAGE_SIZE, bank, bank);
+        if (mbc->dirty == NULL) {
+            return;
+        }
+        const bool *dirty = mbc->dirty + mbc->ram_select * (RAM_BANK_SIZE / PAGE_SIZE);
+        for (uint8_t page = 0; page < SRAM_SIZE / PAGE_SIZE; page++) {
+            if (!dirty[page]) {
+                map_handlers(cpu, (SRAM_START >> BYTE_SIZE) + page, 1, NULL, save_write);
+            }
+        }
+    } else if (mbc->ram_enabled && mbc->cart->mbc == MBC_3 && mbc->ram_select >= RTC_SECONDS &&
+               mbc->ram_select < RTC_SECONDS + RTC_REGISTER_COUNT) {
+        map_handlers(cpu, SRAM_START >> BYTE_SIZE, SRAM_SIZE / PAGE_SIZE, rtc_read, rtc_write);
+    } else {
+        map_handlers(cpu, SRAM_START >> BYTE_SIZE, SRAM_SIZE / PAGE_SIZE, open_bus_read,
+                     open_bus_write);
+    }
+}
+
+/* Bank numbers wrap around at the size of the ROM (always a power of 2) */
+static uint16_t rom_bank(const Mbc *mbc, uint16_t bank) {
+    return bank & (mbc->cart->rom_banks - 1);
+}
+
+static void mbc1_update(CPU *cpu) {
+    Mbc *mbc = cpu->mbc;
+    uint16_t high = (uint16_t)mbc->bank_high << MBC1_BANK_HIGH_SHIFT;
+
+    // Bank 0 can't be selected at 0x4000, 0x20, 0x40 and 0x60 turn into the bank after them
+    mbc->rom_bank = rom_bank(mbc, high | (mbc->bank_low == 0 ? 1 : mbc->bank_low));
+    // In mode 1 the upper bits also select the bank at 0x0000 and the RAM bank
+    mbc->rom_bank0 = mbc->mode ? rom_bank(mbc, high) : 0;
+    mbc->ram_select = mbc->mode && mbc->cart->ram_banks > 0
+                          ? mbc->bank_high & (mbc->cart->ram_banks - 1)
+                          : 0;
+    map_rom(cpu);
+    map_ram(cpu);
+}
+
+static void mbc1_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    Mbc *mbc = cpu->mbc;
+    switch (addr & ~(REG_ROM_BANK - 1)) {
+        case REG_RAM_ENABLE:
+            mbc->ram_enabled = (val & RAM_ENABLE_M) == RAM_ENABLE;
+            break;
+        case REG_ROM_BANK:
+            mbc->bank_low = val & MBC1_BANK_LOW_M;
+            break;
+        case REG_RAM_BANK:
+            mbc->bank_high = val & MBC1_BANK_HIGH_M;
+            break;
+        case REG_MODE:
+            mbc->mode = val & 1;
+            break;
+    }
+    mbc1_update(cpu);
+}
+
+/* MBC2 has a single register range, address bit 8 picks the register */
+static void mbc2_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    Mbc *mbc = cpu->mbc;
+    if (addr >= REG_RAM_BANK) {
+        return;
+    }
+    if (addr & MBC2_REGISTER_BIT) {
+        mbc->bank_low = val & MBC2_BANK_M;
+        mbc->rom_bank = rom_bank(mbc, mbc->bank_low == 0 ? 1 : mbc->bank_low);
+        map_rom(cpu);
+    } else {
+        mbc->ram_enabled = (val & RAM_ENABLE_M) == RAM_ENABLE;
+    }
+}
+
+/* The built-in RAM of MBC2 only stores the lower nibble and repeats
+ * every 512 bytes, so it can't be mapped as plain memory. A write shows
+ * up in every repeat, so code decoded from any of them is dropped.
+ */
+static uint8_t mbc2_ram_read(CPU *cpu, uint16_t addr) {
+    const Mbc *mbc = cpu->mbc;
+    if (!mbc->ram_enabled) {
+        return open_bus_read(cpu, addr);
+    }
+    return mbc->ram[addr & (MBC2_RAM_SIZE - 1)] | (uint8_t)~MBC2_CELL_M;
+}
+
+static void mbc2_ram_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    Mbc *mbc = cpu->mbc;
+    if (mbc->ram_enabled) {
+        mbc->ram[addr & (MBC2_RAM_SIZE - 1)] = val & MBC2_CELL_M;
+        if (mbc->dirty != NULL) {
+            mbc->dirty[(addr & (MBC2_RAM_SIZE - 1)) / PAGE_SIZE] = true;
+        }
+        for (uint32_t repeat = SRAM_START + (addr & (MBC2_RAM_SIZE - 1));
+             repeat < SRAM_START + SRAM_SIZE; repeat += MBC2_RAM_SIZE) {
+            wrote_memory(cpu, repeat);
+        }
+    }
+}
+
+static void mbc3_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    Mbc *mbc = cpu->mbc;
+    switch (addr & ~(REG_ROM_BANK - 1)) {
+        case REG_RAM_ENABLE:
+            mbc->ram_enabled = (val & RAM_ENABLE_M) == RAM_ENABLE;
+            map_ram(cpu);
+            break;
+        case REG_ROM_BANK:
+            mbc->bank_low = val & MBC3_BANK_M;
+            mbc->rom_bank = rom_bank(mbc, mbc->bank_low == 0 ? 1 : mbc->bank_low);
+            map_rom(cpu);
+            break;
+        case REG_RAM_BANK:
+            mbc->ram_select = val;
+            map_ram(cpu);
+            break;
+        case REG_MODE:
+            // Writing 0 and then 1 latches the clock
+            if (mbc->rtc.latch == 0 && val == 1) {
+                latch_rtc(cpu);
+            }
+            mbc->rtc.latch = val;
+            break;
+    }
+}
+
+static void mbc5_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    Mbc *mbc = cpu->mbc;
+    if (addr < REG_ROM_BANK) {
+        mbc->ram_enabled = (val & RAM_ENABLE_M) == RAM_ENABLE;
+        map_ram(cpu);
+    } else if (addr < MBC5_REG_BANK_HIGH) {
+        mbc->bank_low = val;
+        mbc->rom_bank = rom_bank(mbc, (uint16_t)mbc->bank_high << BYTE_SIZE | mbc->bank_low);
+        map_rom(cpu);
+    } else if (addr < REG_RAM_BANK) {
+        mbc->bank_high = val & MBC5_BANK_HIGH_M;
+        mbc->rom_bank = rom_bank(mbc, (uint16_t)mbc->bank_high << BYTE_SIZE | mbc->bank_low);
+        map_rom(cpu);
+    } else if (addr < REG_MODE) {
+        mbc->ram_select = val & MBC5_RAM_BANK_M;
+        map_ram(cpu);
+    }
+}
+
+static const BusWrite mbc_writes[] = {
+    [MBC_NONE] = open_bus_write,
+    [MBC_1] = mbc1_write,
+    [MBC_2] = mbc2_write,
+    [MBC_3] = mbc3_write,
+    [MBC_5] = mbc5_write,
+};
+
+/* init_mbc allocates the cartridge RAM and maps the banks selected
+ * at power on. Returns false if the RAM can't be allocated.
+ */
+bool init_mbc(CPU *cpu, const Cartridge *cart) {
+    Mbc *mbc = calloc(1, sizeof(Mbc));
+    if (mbc == NULL) {
+        return false;
+    }
+    mbc->cart = cart;
+    mbc->ram_size = cart->mbc == MBC_2 ? MBC2_RAM_SIZE : (uint32_t)cart->ram_banks * RAM_BANK_SIZE;
+    if (mbc->ram_size > 0) {
+        mbc->ram = alloc_memory(mbc->ram_size);
+        if (mbc->ram == NULL) {
+            free(mbc);
+            return false;
+        }
+    }
+
+    free_mbc(cpu);
+    cpu->mbc = mbc;
+
+    // Cartridges without an MBC have their RAM always enabled
+    mbc->ram_enabled = cart->mbc == MBC_NONE;
+    mbc->rom_bank = 1;
+    if (cart->mbc == MBC_3) {
+        init_rtc(cpu);
+    }
+    map_rom(cpu);
+    map_handlers(cpu, ROM_START >> BYTE_SIZE, ROM_SIZE / PAGE_SIZE, NULL, mbc_writes[cart->mbc]);
+    if (cart->mbc == MBC_2) {
+        map_handlers(cpu, SRAM_START >> BYTE_SIZE, SRAM_SIZE / PAGE_SIZE, mbc2_ram_read,
+                     mbc2_ram_write);
+    } else {
+        map_ram(cpu);
+    }
+    return true;
+}
+
+/* Writes the dirty pages of a save file back, merging adjacent ones into
+ * one msync() each. Returns false if one of them could not be written.
+ */
+static bool sync_save(Mbc *mbc) {
+    uintptr_t host_page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uint32_t page_count = (mbc->ram_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    bool ok = true;
+
+    for (uint32_t first = 0; first < page_count; first++) {
+        if (!mbc->dirty[first]) {
+            continue;
+        }
+        uint32_t last = first;
+        while (last + 1 < page_count && mbc->dirty[last + 1]) {
+            last++;
+        }
+        // msync() wants the start aligned to the host's pages
+        uintptr_t start = (uintptr_t)(mbc->ram + first * PAGE_SIZE) & ~(host_page - 1);
+        uintptr_t end = (uintptr_t)(mbc->ram + (last + 1) * PAGE_SIZE);
+        if (msync((void *)start, end - start, MS_SYNC) != 0) {
+            perror("msync");
+            ok = false;
+        }
+        for (uint32_t page = first; page <= last; page++) {
+            mbc->dirty[page] = false;
+        }
+        first = last;
+    }
+    return ok;
+}
+
+/* attach_save backs the cartridge RAM with the file at path, which is
+ * created or grown to the size of the RAM. The RAM is mapped straight
+ * from the file, so loading copies nothing and flush_save() only writes
+ * back the pages that changed. Whatever was in the RAM before is dropped.
+ * Returns false if the file can't be mapped or the cartridge has no RAM.
+ */
+bool attach_save(CPU *cpu, const char *path) {
+    Mbc *mbc = cpu->mbc;
+    if (mbc == NULL || mbc->ram_size == 0) {
+        return false;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);  // NOLINT
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (st.st_size < (off_t)mbc->ram_size && ftruncate(fd, mbc->ram_size) != 0)) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after the file is closed
+    void *ram = mmap(NULL, mbc->ram_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ram == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+    bool *dirty = calloc((mbc->ram_size + PAGE_SIZE - 1) / PAGE_SIZE, sizeof(bool));
+    if (dirty == NULL) {
+        munmap(ram, mbc->ram_size);
+        return false;
+    }
+
+    free_memory(mbc->ram, mbc->ram_size);
+    mbc->ram = ram;
+    mbc->dirty = dirty;
+#ifdef FASTMEM
+    forget_fastmem(cpu);
+#endif
+    if (mbc->cart->mbc != MBC_2) {
+        map_ram(cpu);
+    }
+    return true;
+}
+
+/* flush_save writes the pages of the save file changed since the last
+ * flush back to disk. Returns false if that failed.
+ */
+bool flush_save(CPU *cpu) {
+    Mbc *mbc = cpu->mbc;
+    if (mbc == NULL || mbc->dirty == NULL) {
+        return true;
+    }
+    bool ok = sync_save(mbc);
+    // Catch the next write to every page again
+    if (mbc->cart->mbc != MBC_2) {
+        map_ram(cpu);
+    }
+    return ok;
+}
+
+/* Flushes the save file if there is one, so nothing is lost on shutdown */
+void free_mbc(CPU *cpu) {
+    Mbc *mbc = cpu->mbc;
+    if (mbc == NULL) {
+        return;
+    }
+    if (mbc->dirty != NULL) {
+        sync_save(mbc);
+        munmap(mbc->ram, mbc->ram_size);
+        free(mbc->dirty);
+    } else {
+        free_memory(mbc->ram, mbc->ram_size);
+    }
+    free(mbc);
+    cpu->mbc = NULL;
+#ifdef FASTMEM
+    forget_fastmem(cpu);
+#endif
+}
+
+/* mbc_bank returns the bank mapped at addr, which tells apart code
+ * that different banks have at the same address.
+ */
+uint16_t mbc_bank(const Mbc *mbc, uint16_t addr) {
+    if (addr < ROM_BANK_SIZE) {
+        return mbc->rom_bank0;
+    }
+    if (addr < ROM_SIZE) {
+        return mbc->rom_bank;
+    }
+    if (addr >= SRAM_START && addr < SRAM_START + SRAM_SIZE) {
+        return mbc->ram_select;
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "../../include/cpu.h"
+// cpu.h has to come first
+#include "../../include/cartridge.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define SECONDS_PER_MINUTE 60
+#define MINUTES_PER_HOUR 60
+#define HOURS_PER_DAY 24
+#define DAY_COUNT 512 /*The day counter has 9 bits*/
+#define SECONDS_M 0x3F
+#define MINUTES_M 0x3F
+#define HOURS_M 0x1F
+#define DAYS_HIGH_BIT 0x100
+
+/* Whole seconds the clock ran since the start of the running second */
+static uint64_t elapsed(const CPU *cpu, const Rtc *rtc) {
+    if (rtc->halted) {
+        return 0;
+    }
+    if (rtc->emulated) {
+        return (cpu->cycles - rtc->base_cycles) / CLOCK_HZ;
+    }
+    int64_t seconds = (int64_t)time(NULL) - rtc->base_time;
+    return seconds > 0 ? (uint64_t)seconds : 0;
+}
+
+/* Counts a register that wraps at limit up by count and returns how often
+ * it wrapped. A value written past the limit counts up to the size of the
+ * register and wraps to 0 from there without carrying, like on hardware.
+ */
+static uint64_t advance(uint8_t *reg, uint64_t count, uint8_t limit, uint8_t size) {
+    if (*reg >= limit) {
+        if (count < (uint64_t)(size - *reg)) {
+            *reg += count;
+            return 0;
+        }
+        count -= size - *reg;
+        *reg = 0;
+    }
+    uint64_t total = *reg + count;
+    *reg = total % limit;
+    return total / limit;
+}
+
+/* Brings the registers up to date. Only whole seconds are moved from the
+ * base into them, so the part of the running second isn't lost.
+ */
+static void catch_up(CPU *cpu, Rtc *rtc) {
+    uint64_t seconds = elapsed(cpu, rtc);
+    if (seconds == 0) {
+        return;
+    }
+    rtc->base_cycles += seconds * CLOCK_HZ;
+    rtc->base_time += (int64_t)seconds;
+
+    uint64_t minutes = advance(&rtc->second, seconds, SECONDS_PER_MINUTE, SECONDS_M + 1);
+    uint64_t hours = advance(&rtc->minute, minutes, MINUTES_PER_HOUR, MINUTES_M + 1);
+    uint64_t days = rtc->days + advance(&rtc->hour, hours, HOURS_PER_DAY, HOURS_M + 1);
+    // An overflowing day counter wraps around and sets the carry
+    if (days >= DAY_COUNT) {
+        rtc->carry = true;
+    }
+    rtc->days = days % DAY_COUNT;
+}
+
+/* Starts a new second as of now */
+static void restart_second(CPU *cpu, Rtc *rtc) {
+    rtc->base_cycles = cpu->cycles;
+    rtc->base_time = (int64_t)time(NULL);
+    rtc->halted_cycles = rtc->base_cycles;
+    rtc->halted_time = rtc->base_time;
+}
+
+/* The clock stands still while halted, the running second included */
+static void set_halted(CPU *cpu, Rtc *rtc, bool halted) {
+    if (halted && !rtc->halted) {
+        rtc->halted_cycles = cpu->cycles;
+        rtc->halted_time = (int64_t)time(NULL);
+    } else if (!halted && rtc->halted) {
+        rtc->base_cycles += cpu->cycles - rtc->halted_cycles;
+        rtc->base_time += (int64_t)time(NULL) - rtc->halted_time;
+    }
+    rtc->halted = halted;
+}
+
+/* The selected register shows up in the whole RAM window,
+ * so code decoded from it is dropped once the registers change.
+ */
+static void wrote_registers(CPU *cpu) {
+    for (uint32_t addr = SRAM_START; addr < SRAM_START + SRAM_SIZE; addr += PAGE_SIZE) {
+        wrote_memory(cpu, addr);
+    }
+}
+
+/* init_rtc starts the clock of the inserted cartridge at day 0 */
+void init_rtc(CPU *cpu) {
+    Rtc *rtc = &cpu->mbc->rtc;
+    rtc->second = 0;
+    rtc->minute = 0;
+    rtc->hour = 0;
+    rtc->days = 0;
+    rtc->halted = false;
+    rtc->carry = false;
+    restart_second(cpu, rtc);
+}
+
+/* set_rtc_clock makes the clock follow the emulated cycles, which makes
+ * it deterministic for replays, or the host's clock.
+ */
+void set_rtc_clock(CPU *cpu, bool emulated) {
+    Rtc *rtc = &cpu->mbc->rtc;
+    catch_up(cpu, rtc);
+    restart_second(cpu, rtc);
+    rtc->emulated = emulated;
+}
+
+/* latch_rtc copies the current time into the registers the game reads */
+void latch_rtc(CPU *cpu) {
+    Rtc *rtc = &cpu->mbc->rtc;
+    catch_up(cpu, rtc);
+
+    rtc->latched[0] = rtc->second;
+    rtc->latched[1] = rtc->minute;
+    rtc->latched[2] = rtc->hour;
+    rtc->latched[3] = rtc->days & BYTE_M;
+    rtc->latched[4] = (rtc->days >> BYTE_SIZE) | (rtc->halted ? RTC_HALT : 0) |
+                      (rtc->carry ? RTC_CARRY : 0);
+    wrote_registers(cpu);
+}
+
+uint8_t rtc_read(CPU *cpu, uint16_t addr) {
+    (void)addr;
+    const Mbc *mbc = cpu->mbc;
+    return mbc->rtc.latched[mbc->ram_select - RTC_SECONDS];
+}
+
+/* Writes set the running clock, the latched registers keep their values.
+ * Registers keep what was written even past their usual range, and only
+ * writing the seconds starts a new second.
+ */
+void rtc_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    (void)addr;
+    Rtc *rtc = &cpu->mbc->rtc;
+    catch_up(cpu, rtc);
+
+    switch (cpu->mbc->ram_select) {
+        case RTC_SECONDS:
+            rtc->second = val & SECONDS_M;
+            restart_second(cpu, rtc);
+            break;
+        case RTC_MINUTES:
+            rtc->minute = val & MINUTES_M;
+            break;
+        case RTC_HOURS:
+            rtc->hour = val & HOURS_M;
+            break;
+        case RTC_DAYS_LOW:
+            rtc->days = (rtc->days & DAYS_HIGH_BIT) | val;
+            break;
+        case RTC_DAYS_HIGH:
+            rtc->days = (rtc->days & BYTE_M) | ((val & 1) ? DAYS_HIGH_BIT : 0);
+            rtc->carry = val & RTC_CARRY;
+            set_halted(cpu, rtc, val & RTC_HALT);
+            break;
+    }
+    wrote_registers(cpu);
+}
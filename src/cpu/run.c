@@ -0,0 +1,224 @@
+#include "../../include/handlers.h"
+// handlers.h has to come first
+#include "../../include/block_cache.h"
+#include "../../include/aot.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* run_cpu executes instructions until pending_work() says otherwise. It
+ * always executes at least one instruction, and the instruction that crosses
+ * the limit is always finished, so it can run over by a couple of cycles.
+ *
+ * Every instruction is dispatched from inside of the loop, so nothing but
+ * the handler itself is called per opcode.
+ *
+ * The instruction loops keep the program counter and the breakpoint in
+ * locals. The cycles and the limit stay in the CPU: handlers add the cost
+ * of taken branches to cpu->cycles, I/O handlers read it to catch up the
+ * timer, and anything that needs run_until() lowers cpu->limit, so both
+ * would have to be written back and reloaded around every handler anyway.
+ */
+static void run_cpu(CPU *cpu);
+
+/* pending_work() with the program counter and the breakpoint in locals */
+#define PENDING_WORK(pc, breakpoint) ((cpu->cycles >= cpu->limit) | ((pc) == (breakpoint)))
+
+/* run_until runs the CPU until the deadline, stopping on the way
+ * for every event that is due (see scheduler.h) and every interrupt
+ * that can be taken. Events due by the time it returns have all run.
+ */
+static uint32_t run_until(CPU *cpu, uint64_t deadline) {
+    uint64_t start = cpu->cycles;
+
+    cpu->stop = false;
+    for (;;) {
+        run_events(cpu);
+        handle_interrupts(cpu);
+
+        // Starting out on the breakpoint doesn't count, that is how callers resume from it
+        bool breakpoint = cpu->registers.pc == cpu->breakpoint && cpu->cycles != start;
+        if (cpu->cycles >= deadline || breakpoint || cpu->stop) {
+            break;
+        }
+
+        uint64_t next = next_event(&cpu->scheduler);
+        cpu->limit = next < deadline ? next : deadline;
+
+        // Only run the instruction following EI, then set IME
+        bool enabling = cpu->ei_delay;
+        if (enabling) {
+            cpu->limit = cpu->cycles + 1;
+        }
+        run_cpu(cpu);
+        if (enabling) {
+            finish_ei(cpu);
+        }
+    }
+
+    return (uint32_t)(cpu->cycles - start);
+}
+
+uint32_t run_cycles(CPU *cpu, uint32_t budget) { return run_until(cpu, cpu->cycles + budget); }
+
+/* Frames are aligned to multiples of FRAME_CYCLES since power on, so cycles
+ * a frame runs over are taken from the next one and a frame that was
+ * interrupted by a breakpoint is finished by the next call.
+ */
+uint32_t run_frame(CPU *cpu) {
+    uint64_t frame_end = (cpu->cycles / FRAME_CYCLES + 1) * FRAME_CYCLES;
+    return run_until(cpu, frame_end);
+}
+
+#ifdef THREADED_DISPATCH
+
+/* Threaded interpreter
+ *
+ * Every opcode gets its own label which calls the matching handler from
+ * handlers.h and then jumps straight to the label of the next opcode.
+ * Since every label ends in its own indirect jump, the host branch predictor
+ * can learn which opcode usually follows which one, instead of funneling
+ * everything through the single jump of a switch.
+ *
+ * Labels as values and computed gotos are GNU extensions, __extension__
+ * keeps -pedantic from complaining about them.
+ */
+#define LABEL(name) (__extension__ && name)
+#define DISPATCH(label) __extension__({ goto *(label); })
+
+#define NEXT()                           \
+    cpu->registers.pc = pc;              \
+    if (PENDING_WORK(pc, breakpoint)) {  \
+        return;                          \
+    }                                    \
+    DISPATCH(base_labels[mem_read(cpu, pc)])
+
+#define SET_LABEL(opcode, kind, bit_index, jump_cond, target, source) \
+    base_labels[opcode] = LABEL(exec_##opcode);
+#define SET_PF_LABEL(opcode, kind, bit_index, jump_cond, target, source) \
+    pf_labels[opcode] = LABEL(pf_exec_##opcode);
+
+#define EXEC(opcode, kind, bit_index, jump_cond, target, source) \
+    exec_##opcode : cpu->cycles += inst_cycles[opcode];          \
+    pc = op_##opcode(cpu);                                       \
+    NEXT();
+#define PF_EXEC(opcode, kind, bit_index, jump_cond, target, source) \
+    pf_exec_##opcode : cpu->cycles += pf_inst_cycles[opcode];       \
+    pc = pf_op_##opcode(cpu);                                       \
+    NEXT();
+
+static void run_cpu(CPU *cpu) {
+    static void *base_labels[OPCODE_COUNT];
+    static void *pf_labels[OPCODE_COUNT];
+
+    // The label tables can only be filled in from inside of this function
+    if (base_labels[0] == NULL) {
+        for (int opcode = 0; opcode < OPCODE_COUNT; opcode++) {
+            base_labels[opcode] = LABEL(exec_unknown);
+        }
+        BASE_OPCODES(SET_LABEL)
+        PREFIX_OPCODES(SET_PF_LABEL)
+        base_labels[PREFIX_BYTE] = LABEL(exec_prefix);
+    }
+
+    uint16_t pc = cpu->registers.pc;
+    const uint32_t breakpoint = cpu->breakpoint;
+    DISPATCH(base_labels[mem_read(cpu, pc)]);
+
+    // NOLINTBEGIN
+    BASE_OPCODES(EXEC)
+    PREFIX_OPCODES(PF_EXEC)
+    // NOLINTEND
+
+exec_prefix:
+    DISPATCH(pf_labels[mem_read(cpu, pc + 1)]);
+
+    /* Opcodes outside of the opcode map take the same path as in step() */
+exec_unknown:
+    cpu->cycles += inst_cycles[mem_read(cpu, pc)];
+    pc = execute(cpu, &inst_table[mem_read(cpu, pc)]);
+    NEXT();
+}
+
+#elif defined(BLOCK_DISPATCH)
+
+/* Executes one instruction the same way as step() */
+static void run_inst(CPU *cpu) {
+    uint8_t inst_byte = mem_read(cpu, cpu->registers.pc);
+    cpu->cycles += inst_cycles[inst_byte];
+    cpu->registers.pc = op_handlers[inst_byte](cpu);
+}
+
+/* Block interpreter
+ *
+ * Looks up the block at the program counter and runs its instructions
+ * back to back. A block that fits in before cpu->limit runs without
+ * checking it, otherwise the limit is checked after every instruction and
+ * the instructions are dispatched like in step(), so that the flags are
+ * exact wherever the block is left. Either way the block is left early once
+ * one of its instructions overwrote cached code, as it may have overwritten
+ * itself, or lowered the limit (see lower_limit()).
+ *
+ * With DYNAREC, blocks that fit in go through run_native instead, which
+ * switches to compiled code once the block is hot. With AOT, blocks of a
+ * loaded AOT image that fit in take precedence over both.
+ */
+static void run_cpu(CPU *cpu) {
+    do {
+#ifdef AOT
+        const AotBlock *aot = aot_block(cpu, cpu->registers.pc);
+        if (aot != NULL && cpu->cycles + aot->cycles <= cpu->limit) {
+            cpu->code_written = false;
+            aot->run(cpu);
+            continue;
+        }
+#endif
+
+        Block *block = get_block(cpu, cpu->registers.pc);
+        if (block == NULL) {
+            run_inst(cpu);
+        } else {
+            const BlockInst *inst = block->insts;
+            const BlockInst *end = inst + block->inst_count;
+
+            cpu->code_written = false;
+            if (cpu->cycles + block->cycles <= cpu->limit) {
+#ifdef DYNAREC
+                run_native(cpu, block);
+#else
+                for (; inst < end && !cpu->code_written; inst++) {
+                    cpu->cycles += inst->cycles;
+                    cpu->registers.pc = inst->handler(cpu);
+                }
+#endif
+            } else {
+                // May stop in the middle of the block, so skip its flag-free handlers
+                // and split superinstructions up again
+                for (; inst < end && !cpu->code_written && cpu->cycles < cpu->limit; inst++) {
+                    for (int op = 0; op < inst->op_count && !cpu->code_written; op++) {
+                        run_inst(cpu);
+                        if (cpu->cycles >= cpu->limit) {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    } while (!pending_work(cpu));
+}
+
+#else
+
+static void run_cpu(CPU *cpu) {
+    uint16_t pc = cpu->registers.pc;
+    const uint32_t breakpoint = cpu->breakpoint;
+    do {
+        // Same as step(), without the call, the cycle bookkeeping and the events
+        uint8_t inst_byte = mem_read(cpu, pc);
+        cpu->cycles += inst_cycles[inst_byte];
+        pc = op_handlers[inst_byte](cpu);
+        cpu->registers.pc = pc;
+    } while (!PENDING_WORK(pc, breakpoint));
+}
+
+#endif
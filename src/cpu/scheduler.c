@@ -0,0 +1,87 @@
+#include "../../include/cpu.h"
+
+#include <stdint.h>
+
+#define NOT_PENDING 0xFF
+
+static void swap_events(Scheduler *sched, uint8_t a, uint8_t b) {
+    Event event = sched->heap[a];
+    sched->heap[a] = sched->heap[b];
+    sched->heap[b] = event;
+    sched->slots[sched->heap[a].kind] = a;
+    sched->slots[sched->heap[b].kind] = b;
+}
+
+/* Moves the event at index up or down until the heap is in order again */
+static void restore_heap(Scheduler *sched, uint8_t index) {
+    while (index > 0 && sched->heap[index].time < sched->heap[(index - 1) / 2].time) {
+        swap_events(sched, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+    for (;;) {
+        uint8_t smallest = index;
+        uint8_t left = 2 * index + 1;
+        uint8_t right = 2 * index + 2;
+        if (left < sched->size && sched->heap[left].time < sched->heap[smallest].time) {
+            smallest = left;
+        }
+        if (right < sched->size && sched->heap[right].time < sched->heap[smallest].time) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+        swap_events(sched, index, smallest);
+        index = smallest;
+    }
+}
+
+static bool pending(const Scheduler *sched, uint8_t kind) {
+    uint8_t slot = sched->slots[kind];
+    return slot < sched->size && sched->heap[slot].kind == kind;
+}
+
+/* schedule_event makes handler run once cpu->cycles reaches time,
+ * replacing the pending event of the same kind if there is one.
+ */
+void schedule_event(CPU *cpu, uint8_t kind, uint64_t time, EventHandler handler) {
+    Scheduler *sched = &cpu->scheduler;
+    uint8_t index = sched->size;
+    if (pending(sched, kind)) {
+        index = sched->slots[kind];
+    } else {
+        sched->size++;
+    }
+    sched->heap[index] = (Event){time, kind};
+    sched->slots[kind] = index;
+    sched->handlers[kind] = handler;
+    restore_heap(sched, index);
+
+    // Stop the running CPU in time for it
+    lower_limit(cpu, time);
+}
+
+void cancel_event(CPU *cpu, uint8_t kind) {
+    Scheduler *sched = &cpu->scheduler;
+    if (!pending(sched, kind)) {
+        return;
+    }
+    uint8_t index = sched->slots[kind];
+    sched->size--;
+    sched->slots[kind] = NOT_PENDING;
+    if (index < sched->size) {
+        sched->heap[index] = sched->heap[sched->size];
+        sched->slots[sched->heap[index].kind] = index;
+        restore_heap(sched, index);
+    }
+}
+
+/* run_events runs the handlers of every event that is due, in order */
+void run_events(CPU *cpu) {
+    Scheduler *sched = &cpu->scheduler;
+    while (sched->size > 0 && sched->heap[0].time <= cpu->cycles) {
+        Event event = sched->heap[0];
+        cancel_event(cpu, event.kind);
+        sched->handlers[event.kind](cpu, event.time);
+    }
+}
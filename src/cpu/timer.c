@@ -0,0 +1,114 @@
+#include "../../include/cpu.h"
+
+#include <stdint.h>
+
+#define TAC_UNUSED_M 0xF8 /*Upper bits of TAC read as 1*/
+
+/* Bit of the internal counter whose falling edge ticks TIMA, by TAC clock select */
+static const uint8_t clock_bits[] = {9, 3, 5, 7};
+
+static uint16_t internal_counter(const CPU *cpu) {
+    return (uint16_t)(cpu->cycles - cpu->timer.div_base);
+}
+
+/* Cycles between two ticks of TIMA */
+static uint64_t tick_period(const Timer *timer) {
+    return (uint64_t)2 << clock_bits[timer->tac & TAC_CLOCK_M];
+}
+
+/* What TIMA is clocked by, the timer only ticks when this goes from 1 to 0 */
+static bool timer_input(const CPU *cpu, uint8_t tac) {
+    return (tac & TAC_ENABLE) && (internal_counter(cpu) >> clock_bits[tac & TAC_CLOCK_M]) & 1;
+}
+
+/* Adds ticks to TIMA, reloading it from TMA and requesting
+ * the interrupt for every overflow on the way.
+ */
+static void tick_tima(CPU *cpu, uint64_t ticks) {
+    Timer *timer = &cpu->timer;
+    while (ticks >= (uint64_t)0x100 - timer->tima) {
+        ticks -= 0x100 - timer->tima;
+        timer->tima = timer->tma;
+        request_interrupt(cpu, INT_TIMER);
+    }
+    timer->tima += ticks;
+}
+
+/* sync_timer brings TIMA up to cpu->cycles by counting the falling edges
+ * since it last was. Overflows on the way request their interrupt, so IF
+ * is exact even if the overflow event hasn't run yet.
+ */
+void sync_timer(CPU *cpu) {
+    Timer *timer = &cpu->timer;
+    if (timer->tac & TAC_ENABLE) {
+        uint64_t period = tick_period(timer);
+        uint64_t edges = (cpu->cycles - timer->div_base) / period -
+                         (timer->tima_time - timer->div_base) / period;
+        tick_tima(cpu, edges);
+    }
+    timer->tima_time = cpu->cycles;
+}
+
+static void timer_overflow(CPU *cpu, uint64_t time);
+
+/* Schedules the overflow TIMA is headed for, as the one and only timer event */
+static void schedule_overflow(CPU *cpu) {
+    Timer *timer = &cpu->timer;
+    if (!(timer->tac & TAC_ENABLE)) {
+        cancel_event(cpu, EVENT_TIMER);
+        return;
+    }
+    uint64_t period = tick_period(timer);
+    uint64_t edge = (cpu->cycles - timer->div_base) / period + (0x100 - timer->tima);
+    schedule_event(cpu, EVENT_TIMER, timer->div_base + edge * period, timer_overflow);
+}
+
+static void timer_overflow(CPU *cpu, uint64_t time) {
+    (void)time;
+    sync_timer(cpu);
+    schedule_overflow(cpu);
+}
+
+uint8_t read_timer(CPU *cpu, uint16_t addr) {
+    switch (addr) {
+        case IO_DIV:
+            return internal_counter(cpu) >> BYTE_SIZE;
+        case IO_TIMA:
+            sync_timer(cpu);
+            return cpu->timer.tima;
+        case IO_TMA:
+            return cpu->timer.tma;
+        default:
+            return cpu->timer.tac | TAC_UNUSED_M;
+    }
+}
+
+/* Resetting DIV or changing TAC can turn the timer input from 1 to 0,
+ * which ticks TIMA just like the counter would.
+ */
+void write_timer(CPU *cpu, uint16_t addr, uint8_t val) {
+    Timer *timer = &cpu->timer;
+    sync_timer(cpu);
+
+    switch (addr) {
+        case IO_DIV:
+            if (timer_input(cpu, timer->tac)) {
+                tick_tima(cpu, 1);
+            }
+            timer->div_base = cpu->cycles;
+            break;
+        case IO_TIMA:
+            timer->tima = val;
+            break;
+        case IO_TMA:
+            timer->tma = val;
+            break;
+        default:
+            if (timer_input(cpu, timer->tac) && !timer_input(cpu, val)) {
+                tick_tima(cpu, 1);
+            }
+            timer->tac = val & (TAC_ENABLE | TAC_CLOCK_M);
+            break;
+    }
+    schedule_overflow(cpu);
+}
@@ -1,12 +1,77 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "../include/cpu.h"
+// cpu.h has to come first
+#include "../include/cartridge.h"
 
 #define PRIu8 "%hhu"
 #define PRIu16 "%hu"
 
-int main(void) {
-    printf("Hello, world!\n");
+#define ENTRY_POINT 0x0100
+#define STACK_START 0xFFFE
+#define SAVE_INTERVAL 60 /*Frames between flushes of battery RAM, about a second*/
 
-    return 0;
+/* Battery RAM is saved next to the ROM, with .sav in place of its extension */
+static char *save_path(const char *rom_path) {
+    const char *dot = strrchr(rom_path, '.');
+    const char *slash = strrchr(rom_path, '/');
+    size_t stem = dot != NULL && (slash == NULL || dot > slash) ? (size_t)(dot - rom_path)
+                                                                : strlen(rom_path);
+    char *path = malloc(stem + sizeof(".sav"));
+    if (path != NULL) {
+        memcpy(path, rom_path, stem);
+        strcpy(path + stem, ".sav");
+    }
+    return path;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <rom> [frames] [save interval]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Cartridge *cart = load_cartridge(argv[1]);
+    if (cart == NULL) {
+        return EXIT_FAILURE;
+    }
+    printf("%s: type 0x%02X, " PRIu16 " ROM banks, " PRIu8 " RAM banks\n", cart->title, cart->type,
+           cart->rom_banks, cart->ram_banks);
+
+    // Where the boot ROM leaves off
+    CPU cpu = new_cpu();
+    if (!insert_cartridge(&cpu, cart)) {
+        fprintf(stderr, "%s: can't allocate cartridge RAM\n", argv[1]);
+        free_cpu(&cpu);
+        free_cartridge(cart);
+        return EXIT_FAILURE;
+    }
+    cpu.registers.pc = ENTRY_POINT;
+    cpu.registers.sp = STACK_START;
+
+    if (cart->battery && cpu.mbc->ram_size > 0) {
+        char *path = save_path(argv[1]);
+        if (path == NULL || !attach_save(&cpu, path)) {
+            fprintf(stderr, "%s: battery RAM won't be saved\n", argv[1]);
+        }
+        free(path);
+    }
+
+    long frames = argc > 2 ? strtol(argv[2], NULL, 0) : 0;
+    long save_interval = argc > 3 ? strtol(argv[3], NULL, 0) : SAVE_INTERVAL;
+    for (long frame = 0; frame < frames; frame++) {
+        run_frame(&cpu);
+        if (save_interval > 0 && (frame + 1) % save_interval == 0) {
+            flush_save(&cpu);
+        }
+    }
+    if (frames > 0) {
+        print_regs(&cpu);
+    }
+
+    free_cpu(&cpu);
+    free_cartridge(cart);
+    return EXIT_SUCCESS;
 }
@@ -1,7 +1,17 @@
+// mkstemp() and unlink() are POSIX and not part of C11
+#define _DEFAULT_SOURCE
+
 #include <assert.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-#include "../include/cpu.h"
+#include "../include/handlers.h"
+// handlers.h has to come first
+#include "../include/aot.h"
+#include "../include/cartridge.h"
 
 #define BIN(binary) (__extension__ binary)
 
@@ -31,7 +41,8 @@ void test_add(void) {
     Instruction Iadd = new_add(O_B);
     execute(&cpu, &Iadd);
     assert(cpu.registers.a == BIN(0b00010000));
-    assert(cpu.registers.f == BIN(0b00100000));
+    assert(get_reg(&cpu, F) == BIN(0b00100000));
+    free_cpu(&cpu);
 }
 
 void test_addhl(void) {
@@ -45,6 +56,7 @@ void test_addhl(void) {
     Instruction Iaddhl = new_add(O_HL);
     execute(&cpu, &Iaddhl);
     assert(get_hl(&cpu.registers) == BIN(0b0000000000010000));
+    free_cpu(&cpu);
 }
 
 void test_adc(void) {
@@ -56,13 +68,14 @@ void test_adc(void) {
 
     Instruction Iset2 = new_set(4, O_F);
     execute(&cpu, &Iset2);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Iadc = new_adc(O_B);
     execute(&cpu, &Iadc);
     assert(cpu.registers.a == BIN(0b00001001));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_sub(void) {
@@ -79,7 +92,8 @@ void test_sub(void) {
     Instruction Isub = new_sub(O_B);
     execute(&cpu, &Isub);
     assert(cpu.registers.a == BIN(0b00000000));
-    assert(cpu.registers.f == BIN(0b11000000));
+    assert(get_reg(&cpu, F) == BIN(0b11000000));
+    free_cpu(&cpu);
 }
 
 void test_sbc(void) {
@@ -95,13 +109,14 @@ void test_sbc(void) {
 
     Instruction Iset3 = new_set(4, O_F);
     execute(&cpu, &Iset3);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Isbc = new_sbc(O_B);
     execute(&cpu, &Isbc);
     assert(cpu.registers.a == BIN(0b11111111));
-    assert(cpu.registers.f == BIN(0b01110000));
+    assert(get_reg(&cpu, F) == BIN(0b01110000));
+    free_cpu(&cpu);
 }
 
 void test_and(void) {
@@ -118,7 +133,8 @@ void test_and(void) {
     Instruction Iand = new_and(O_B);
     execute(&cpu, &Iand);
     assert(cpu.registers.a == BIN(0b00000001));
-    assert(cpu.registers.f == BIN(0b00100000));
+    assert(get_reg(&cpu, F) == BIN(0b00100000));
+    free_cpu(&cpu);
 }
 
 void test_or(void) {
@@ -135,7 +151,8 @@ void test_or(void) {
     Instruction Ior = new_and(O_B);
     execute(&cpu, &Ior);
     assert(cpu.registers.a == BIN(0b00000001));
-    assert(cpu.registers.f == BIN(0b00100000));
+    assert(get_reg(&cpu, F) == BIN(0b00100000));
+    free_cpu(&cpu);
 }
 
 void test_xor(void) {
@@ -152,7 +169,8 @@ void test_xor(void) {
     Instruction Ixor = new_xor(O_B);
     execute(&cpu, &Ixor);
     assert(cpu.registers.a == BIN(0b00011000));
-    assert(cpu.registers.f == BIN(0b00100000));
+    assert(get_reg(&cpu, F) == BIN(0b00100000));
+    free_cpu(&cpu);
 }
 
 void test_cp(void) {
@@ -168,7 +186,8 @@ void test_cp(void) {
 
     Instruction Icp = new_cp(O_B);
     execute(&cpu, &Icp);
-    assert(cpu.registers.f == BIN(0b11000000));
+    assert(get_reg(&cpu, F) == BIN(0b11000000));
+    free_cpu(&cpu);
 }
 
 void test_inc(void) {
@@ -182,7 +201,7 @@ void test_inc(void) {
     Instruction Iinc = new_inc(O_HL);
     execute(&cpu, &Iinc);
     assert(get_hl(&cpu.registers) == BIN(0b0000000000001001));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
 
     Instruction Iset2 = new_set(3, O_B);
     execute(&cpu, &Iset2);
@@ -191,7 +210,8 @@ void test_inc(void) {
     Instruction Iinc2 = new_inc(O_B);
     execute(&cpu, &Iinc2);
     assert(cpu.registers.b == BIN(0b00001001));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_dec(void) {
@@ -205,7 +225,7 @@ void test_dec(void) {
     Instruction Idec = new_dec(O_HL);
     execute(&cpu, &Idec);
     assert(get_hl(&cpu.registers) == BIN(0b0000000000000111));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
 
     Instruction Iset2 = new_set(3, O_B);
     execute(&cpu, &Iset2);
@@ -214,7 +234,8 @@ void test_dec(void) {
     Instruction Idec2 = new_dec(O_B);
     execute(&cpu, &Idec2);
     assert(cpu.registers.b == BIN(0b00000111));
-    assert(cpu.registers.f == BIN(0b01100000));
+    assert(get_reg(&cpu, F) == BIN(0b01100000));
+    free_cpu(&cpu);
 }
 
 void test_ccf(void) {
@@ -222,12 +243,13 @@ void test_ccf(void) {
 
     Instruction Iset = new_set(4, O_F);
     execute(&cpu, &Iset);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Iccf = new_ccf();
     execute(&cpu, &Iccf);
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_scf(void) {
@@ -235,7 +257,8 @@ void test_scf(void) {
 
     Instruction Iscf = new_scf();
     execute(&cpu, &Iscf);
-    assert(cpu.registers.f == BIN(0b00010000));
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    free_cpu(&cpu);
 }
 
 void test_rra(void) {
@@ -248,7 +271,8 @@ void test_rra(void) {
     Instruction Irra = new_rra();
     execute(&cpu, &Irra);
     assert(cpu.registers.a == BIN(0b00000000));
-    assert(cpu.registers.f == BIN(0b10010000));
+    assert(get_reg(&cpu, F) == BIN(0b10010000));
+    free_cpu(&cpu);
 }
 
 void test_rla(void) {
@@ -260,13 +284,14 @@ void test_rla(void) {
 
     Instruction Iset2 = new_set(4, O_F);
     execute(&cpu, &Iset2);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Irla = new_rla();
     execute(&cpu, &Irla);
     assert(cpu.registers.a == BIN(0b00000011));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_rrca(void) {
@@ -279,7 +304,8 @@ void test_rrca(void) {
     Instruction Irrca = new_rrca();
     execute(&cpu, &Irrca);
     assert(cpu.registers.a == BIN(0b10000000));
-    assert(cpu.registers.f == BIN(0b00010000));
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    free_cpu(&cpu);
 }
 
 void test_rlca(void) {
@@ -291,13 +317,14 @@ void test_rlca(void) {
 
     Instruction Iset2 = new_set(4, O_F);
     execute(&cpu, &Iset2);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Irlca = new_rlca();
     execute(&cpu, &Irlca);
     assert(cpu.registers.a == BIN(0b00000010));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_cpl(void) {
@@ -310,7 +337,8 @@ void test_cpl(void) {
     Instruction Icpl = new_cpl();
     execute(&cpu, &Icpl);
     assert(cpu.registers.a == BIN(0b11111110));
-    assert(cpu.registers.f == BIN(0b01100000));
+    assert(get_reg(&cpu, F) == BIN(0b01100000));
+    free_cpu(&cpu);
 }
 
 void test_bit(void) {
@@ -322,7 +350,8 @@ void test_bit(void) {
 
     Instruction Ibit = new_bit(3, O_A);
     execute(&cpu, &Ibit);
-    assert(cpu.registers.f == BIN(0b00100000));
+    assert(get_reg(&cpu, F) == BIN(0b00100000));
+    free_cpu(&cpu);
 }
 
 void test_reset(void) {
@@ -335,7 +364,8 @@ void test_reset(void) {
     Instruction Ireset = new_reset(3, O_A);
     execute(&cpu, &Ireset);
     assert(cpu.registers.a == BIN(0b00000000));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_set(void) {
@@ -344,7 +374,8 @@ void test_set(void) {
     Instruction Iset = new_set(3, O_A);
     execute(&cpu, &Iset);
     assert(cpu.registers.a == BIN(0b00001000));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_srl(void) {
@@ -361,7 +392,8 @@ void test_srl(void) {
     Instruction Isrl = new_srl(O_B);
     execute(&cpu, &Isrl);
     assert(cpu.registers.b == BIN(0b01000000));
-    assert(cpu.registers.f == BIN(0b00010000));
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    free_cpu(&cpu);
 }
 
 void test_rr(void) {
@@ -373,13 +405,14 @@ void test_rr(void) {
 
     Instruction Iset2 = new_set(4, O_F);
     execute(&cpu, &Iset2);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Irr = new_rr(O_B);
     execute(&cpu, &Irr);
     assert(cpu.registers.b == BIN(0b10000100));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_rl(void) {
@@ -391,13 +424,14 @@ void test_rl(void) {
 
     Instruction Iset2 = new_set(4, O_F);
     execute(&cpu, &Iset2);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Irl = new_rl(O_B);
     execute(&cpu, &Irl);
     assert(cpu.registers.b == BIN(0b00010001));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_rrc(void) {
@@ -409,13 +443,14 @@ void test_rrc(void) {
 
     Instruction Iset2 = new_set(4, O_F);
     execute(&cpu, &Iset2);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Irrc = new_rrc(O_B);
     execute(&cpu, &Irrc);
     assert(cpu.registers.b == BIN(0b00000100));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_rlc(void) {
@@ -427,13 +462,14 @@ void test_rlc(void) {
 
     Instruction Iset2 = new_set(4, O_F);
     execute(&cpu, &Iset2);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Irlc = new_rlc(O_B);
     execute(&cpu, &Irlc);
     assert(cpu.registers.b == BIN(0b00010000));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_sra(void) {
@@ -449,13 +485,14 @@ void test_sra(void) {
 
     Instruction Iset3 = new_set(4, O_F);
     execute(&cpu, &Iset3);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Isra = new_sra(O_B);
     execute(&cpu, &Isra);
     assert(cpu.registers.b == BIN(0b11000100));
-    assert(cpu.registers.f == BIN(0b00000000));
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
 }
 
 void test_sla(void) {
@@ -471,13 +508,14 @@ void test_sla(void) {
 
     Instruction Iset3 = new_set(4, O_F);
     execute(&cpu, &Iset3);
-    assert(cpu.registers.f == BIN(0b00010000));
-    cpu.flag_reg.carry = true;
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    cpu.registers.f |= CARRY_FLAG_M;
 
     Instruction Isla = new_sla(O_B);
     execute(&cpu, &Isla);
     assert(cpu.registers.b == BIN(0b00010000));
-    assert(cpu.registers.f == BIN(0b00010000));
+    assert(get_reg(&cpu, F) == BIN(0b00010000));
+    free_cpu(&cpu);
 }
 
 void test_swap(void) {
@@ -494,6 +532,7 @@ void test_swap(void) {
     Instruction Iswap = new_swap(O_B);
     execute(&cpu, &Iswap);
     assert(cpu.registers.b == BIN(0b10100000));
+    free_cpu(&cpu);
 }
 
 void test_jp() {
@@ -501,14 +540,15 @@ void test_jp() {
 
     Instruction Iset = new_set(7, O_F);  // NOLINT
     execute(&cpu, &Iset);
-    assert(cpu.registers.f == BIN(0b10000000));
-    cpu.flag_reg.zero = true;
+    assert(get_reg(&cpu, F) == BIN(0b10000000));
+    cpu.registers.f |= ZERO_FLAG_M;
 
     Instruction Ijp = new_jp(ZERO);
-    cpu.memory[cpu.prog_count + 1] = 0x10;  // LSB NOLINT
-    cpu.memory[cpu.prog_count + 2] = 0xC0;  // MSB NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0x10);  // LSB NOLINT
+    mem_write(&cpu, cpu.registers.pc + 2, 0xC0);  // MSB NOLINT
     uint16_t new_pc = execute(&cpu, &Ijp);
     assert(new_pc == 0xC010);
+    free_cpu(&cpu);
 }
 
 void test_jphl() {
@@ -522,6 +562,7 @@ void test_jphl() {
     Instruction Ijphl = new_jp_hl();
     uint16_t new_pc = execute(&cpu, &Ijphl);
     assert(new_pc == BIN(0b0000000000000100));
+    free_cpu(&cpu);
 }
 
 void test_jr() {
@@ -529,15 +570,16 @@ void test_jr() {
 
     Instruction Iset = new_set(7, O_F);  // NOLINT
     execute(&cpu, &Iset);
-    assert(cpu.registers.f == BIN(0b10000000));
-    cpu.flag_reg.zero = true;
+    assert(get_reg(&cpu, F) == BIN(0b10000000));
+    cpu.registers.f |= ZERO_FLAG_M;
 
-    cpu.prog_count = 0x0012;  // NOLINT
+    cpu.registers.pc = 0x0012;  // NOLINT
 
     Instruction Ijr = new_jr(ZERO);
-    cpu.memory[cpu.prog_count + 1] = 0xFE;  // signed offset NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0xFE);  // signed offset NOLINT
     uint16_t new_pc = execute(&cpu, &Ijr);
     assert(new_pc == 0x0010);
+    free_cpu(&cpu);
 }
 
 void test_ld_reg() {
@@ -554,27 +596,30 @@ void test_ld_reg() {
     Instruction Ild = new_ld(O_B, O_C);
     execute(&cpu, &Ild);
     assert(cpu.registers.b == BIN(0b00001000));
+    free_cpu(&cpu);
 }
 
 void test_ld_d8() {
     CPU cpu = new_cpu();
 
-    cpu.memory[cpu.prog_count + 1] = 0xFF;  // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0xFF);  // NOLINT
 
     Instruction Ild = new_ld(O_C, O_D8);
     execute(&cpu, &Ild);
     assert(cpu.registers.c == BIN(0b11111111));
+    free_cpu(&cpu);
 }
 
 void test_ld_d16() {
     CPU cpu = new_cpu();
 
-    cpu.memory[cpu.prog_count + 1] = 0xCD;  // NOLINT
-    cpu.memory[cpu.prog_count + 2] = 0xAB;  // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0xCD);  // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 2, 0xAB);  // NOLINT
 
     Instruction Ild = new_ld(O_DE, O_D16);
     execute(&cpu, &Ild);
     assert(get_de(&cpu.registers) == 0xABCD);
+    free_cpu(&cpu);
 }
 
 void test_ld_d8_ind() {
@@ -585,11 +630,12 @@ void test_ld_d8_ind() {
     execute(&cpu, &Iset);
     assert(get_reg(&cpu, HL) == BIN(0b0000000000000100));
 
-    cpu.memory[cpu.prog_count + 1] = 0xEF;  // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0xEF);  // NOLINT
 
     Instruction Ild = new_ld(O_HL_IND, O_D8);
     execute(&cpu, &Ild);
-    assert(cpu.memory[4] == 0xEF);
+    assert(mem_read(&cpu, 4) == 0xEF);
+    free_cpu(&cpu);
 }
 
 void test_ld_ind() {
@@ -600,7 +646,7 @@ void test_ld_ind() {
     execute(&cpu, &Iset);
     assert(get_reg(&cpu, BC) == BIN(0b0000000000000100));
 
-    cpu.memory[4] = 0xAB;  // NOLINT
+    mem_write(&cpu, 4, 0xAB);  // NOLINT
 
     Instruction Ild = new_ld(O_D, O_BC_IND);
     execute(&cpu, &Ild);
@@ -612,15 +658,16 @@ void test_ld_ind() {
 
     Instruction Ild2 = new_ld(O_BC_IND, O_A);
     execute(&cpu, &Ild2);
-    assert(cpu.memory[4] == 0x02);
+    assert(mem_read(&cpu, 4) == 0x02);
+    free_cpu(&cpu);
 }
 
 void test_ld_addr() {
     CPU cpu = new_cpu();
 
-    cpu.memory[5] = 0x11;                   // NOLINT
-    cpu.memory[cpu.prog_count + 1] = 0x05;  // addr LSB NOLINT
-    cpu.memory[cpu.prog_count + 2] = 0x00;  // addr MSB NOLINT
+    mem_write(&cpu, 5, 0x11);                     // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0x05);  // addr LSB NOLINT
+    mem_write(&cpu, cpu.registers.pc + 2, 0x00);  // addr MSB NOLINT
 
     Instruction Ild = new_ld(O_D, O_A16_IND);
     execute(&cpu, &Ild);
@@ -632,7 +679,8 @@ void test_ld_addr() {
 
     Instruction Ild2 = new_ld(O_A16_IND, O_A);
     execute(&cpu, &Ild2);
-    assert(cpu.memory[5] == 0x02);
+    assert(mem_read(&cpu, 5) == 0x02);
+    free_cpu(&cpu);
 }
 
 void test_ld_inc() {
@@ -643,7 +691,7 @@ void test_ld_inc() {
     execute(&cpu, &Iset);
     assert(get_reg(&cpu, HL) == BIN(0b0000000000000100));
 
-    cpu.memory[4] = 0xAB;  // NOLINT
+    mem_write(&cpu, 4, 0xAB);  // NOLINT
 
     Instruction Ild = new_ld(O_B, O_HL_INC_IND);
     execute(&cpu, &Ild);
@@ -656,8 +704,9 @@ void test_ld_inc() {
 
     Instruction Ild2 = new_ld(O_HL_INC_IND, O_A);
     execute(&cpu, &Ild2);
-    assert(cpu.memory[5] == 0x02);
+    assert(mem_read(&cpu, 5) == 0x02);
     assert(get_reg(&cpu, HL) == BIN(0b0000000000000110));
+    free_cpu(&cpu);
 }
 
 void test_ld_dec() {
@@ -668,7 +717,7 @@ void test_ld_dec() {
     execute(&cpu, &Iset);
     assert(get_reg(&cpu, HL) == BIN(0b0000000000000100));
 
-    cpu.memory[4] = 0xAB;  // NOLINT
+    mem_write(&cpu, 4, 0xAB);  // NOLINT
 
     Instruction Ild = new_ld(O_B, O_HL_DEC_IND);
     execute(&cpu, &Ild);
@@ -681,8 +730,9 @@ void test_ld_dec() {
 
     Instruction Ild2 = new_ld(O_HL_DEC_IND, O_A);
     execute(&cpu, &Ild2);
-    assert(cpu.memory[3] == 0x02);
+    assert(mem_read(&cpu, 3) == 0x02);
     assert(get_reg(&cpu, HL) == BIN(0b0000000000000010));
+    free_cpu(&cpu);
 }
 
 void test_ldh_ind() {
@@ -692,7 +742,10 @@ void test_ldh_ind() {
     execute(&cpu, &Iset);
     assert(get_reg(&cpu, (enum RegisterName)O_C) == BIN(0b00000100));
 
-    cpu.memory[0xFF04] = 0xAB;  // NOLINT
+    // Point C at HRAM, 0xFF04 is DIV
+    Instruction Iset7 = new_set(7, O_C);  // NOLINT
+    execute(&cpu, &Iset7);
+    mem_write(&cpu, 0xFF84, 0xAB);  // NOLINT
 
     Instruction Ildh = new_ldh(O_B, O_C_IND);
     execute(&cpu, &Ildh);
@@ -704,14 +757,15 @@ void test_ldh_ind() {
 
     Instruction Ildh2 = new_ldh(O_C_IND, O_A);
     execute(&cpu, &Ildh2);
-    assert(cpu.memory[0xFF04] == 0x02);
+    assert(mem_read(&cpu, 0xFF84) == 0x02);
+    free_cpu(&cpu);
 }
 
 void test_ldh_addr() {
     CPU cpu = new_cpu();
 
-    cpu.memory[0xFF04] = 0xAB;              // NOLINT
-    cpu.memory[cpu.prog_count + 1] = 0x04;  // half addr
+    mem_write(&cpu, 0xFF84, 0xAB);                // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0x84);  // half addr
 
     Instruction Ildh = new_ldh(O_B, O_A8_IND);
     execute(&cpu, &Ildh);
@@ -723,84 +777,89 @@ void test_ldh_addr() {
 
     Instruction Ildh2 = new_ldh(O_A8_IND, O_A);
     execute(&cpu, &Ildh2);
-    assert(cpu.memory[0xFF04] == 0x02);
+    assert(mem_read(&cpu, 0xFF84) == 0x02);
+    free_cpu(&cpu);
 }
 
 void test_push() {
     CPU cpu = new_cpu();
     // NOTE: we will assume that the stack begins at the end of memory (growing downwards)
-    cpu.stack_pointer = 0xFFFE;  // NOLINT
+    cpu.registers.sp = 0xFFFE;  // NOLINT
 
     cpu.registers.a = 0xF0;  // NOLINT
     cpu.registers.f = 0x01;
 
     Instruction Ipush = new_push(O_AF);
     execute(&cpu, &Ipush);
-    assert(cpu.memory[0xFFFD] == 0xF0);
-    assert(cpu.memory[0xFFFC] == 0x01);
+    assert(mem_read(&cpu, 0xFFFD) == 0xF0);
+    assert(mem_read(&cpu, 0xFFFC) == 0x01);
+    free_cpu(&cpu);
 }
 
 void test_pop() {
     CPU cpu = new_cpu();
     // NOTE: we will assume that the stack begins at the end of memory (growing downwards)
-    cpu.stack_pointer = 0xFFFE;  // NOLINT
+    cpu.registers.sp = 0xFFFE;  // NOLINT
 
     cpu.registers.a = 0xF0;  // NOLINT
     cpu.registers.f = 0x10;  // NOLINT
 
     Instruction Ipush = new_push(O_AF);
     execute(&cpu, &Ipush);
-    assert(cpu.memory[0xFFFD] == 0xF0);
-    assert(cpu.memory[0xFFFC] == 0x10);
+    assert(mem_read(&cpu, 0xFFFD) == 0xF0);
+    assert(mem_read(&cpu, 0xFFFC) == 0x10);
 
     cpu.registers.f = 0xFF;  // NOLINT
 
     Instruction Ipop = new_pop(O_AF);
     execute(&cpu, &Ipop);
     assert(get_reg(&cpu, AF) == 0xF010);
-    assert(!cpu.flag_reg.zero);
-    assert(!cpu.flag_reg.subtract);
-    assert(!cpu.flag_reg.half_carry);
-    assert(cpu.flag_reg.carry);
+    assert(!zero_flag(&cpu));
+    assert(!(cpu.registers.f & SUBTRACT_FLAG_M));
+    assert(!(cpu.registers.f & HALF_CARRY_FLAG_M));
+    assert(carry_flag(&cpu));
+    free_cpu(&cpu);
 }
 
 void test_call() {
     CPU cpu = new_cpu();
     // NOTE: we will assume that the stack begins at the end of memory (growing downwards)
-    cpu.stack_pointer = 0xFFFE;  // NOLINT
+    cpu.registers.sp = 0xFFFE;  // NOLINT
 
-    cpu.prog_count = 0xFF00;                // NOLINT
-    cpu.memory[cpu.prog_count + 1] = 0xCD;  // NOLINT
-    cpu.memory[cpu.prog_count + 2] = 0xAB;  // NOLINT
+    cpu.registers.pc = 0xFF00;                // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0xCD);  // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 2, 0xAB);  // NOLINT
 
     Instruction Icall = new_call(NOT_ZERO);
     uint16_t next_pc = execute(&cpu, &Icall);
 
     assert(next_pc == 0xABCD);
-    assert(cpu.memory[0xFFFD] == 0xFF);
-    assert(cpu.memory[0xFFFC] == 0x03);
+    assert(mem_read(&cpu, 0xFFFD) == 0xFF);
+    assert(mem_read(&cpu, 0xFFFC) == 0x03);
+    free_cpu(&cpu);
 }
 
 void test_ret() {
     CPU cpu = new_cpu();
     // NOTE: we will assume that the stack begins at the end of memory (growing downwards)
-    cpu.stack_pointer = 0xFFFE;  // NOLINT
+    cpu.registers.sp = 0xFFFE;  // NOLINT
 
-    cpu.prog_count = 0xFF00;                // NOLINT
-    cpu.memory[cpu.prog_count + 1] = 0xCD;  // NOLINT
-    cpu.memory[cpu.prog_count + 2] = 0xAB;  // NOLINT
+    cpu.registers.pc = 0xFF00;                // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 1, 0xCD);  // NOLINT
+    mem_write(&cpu, cpu.registers.pc + 2, 0xAB);  // NOLINT
 
     Instruction Icall = new_call(NOT_ZERO);
     uint16_t next_pc = execute(&cpu, &Icall);
 
     assert(next_pc == 0xABCD);
-    assert(cpu.memory[0xFFFD] == 0xFF);
-    assert(cpu.memory[0xFFFC] == 0x03);
+    assert(mem_read(&cpu, 0xFFFD) == 0xFF);
+    assert(mem_read(&cpu, 0xFFFC) == 0x03);
 
     Instruction Iret = new_ret(NOT_CARRY);
     next_pc = execute(&cpu, &Iret);
 
     assert(next_pc == 0xFF03);
+    free_cpu(&cpu);
 }
 
 void test_nop() {
@@ -809,9 +868,1173 @@ void test_nop() {
     Instruction Inop = new_nop();
     uint16_t new_pc = execute(&cpu, &Inop);
     assert(new_pc == 1);
+    free_cpu(&cpu);
+}
+
+void test_step() {
+    CPU cpu = new_cpu();
+
+    mem_write(&cpu, 0, 0x06);  // LD B, d8 NOLINT
+    mem_write(&cpu, 1, 0x42);  // NOLINT
+    mem_write(&cpu, 2, 0xCB);  // prefix NOLINT
+    mem_write(&cpu, 3, 0xC7);  // SET 0, A NOLINT
+    mem_write(&cpu, 4, 0x80);  // ADD A, B NOLINT
+
+    assert(step(&cpu) == 8);
+    assert(cpu.registers.b == 0x42);
+    assert(cpu.registers.pc == 2);
+
+    assert(step(&cpu) == 8);
+    assert(cpu.registers.a == BIN(0b00000001));
+    assert(cpu.registers.pc == 4);
+
+    assert(step(&cpu) == 4);
+    assert(cpu.registers.a == 0x43);
+    assert(cpu.registers.pc == 5);
+    assert(cpu.cycles == 8 + 8 + 4);
+    free_cpu(&cpu);
+}
+
+void test_cycles() {
+    CPU cpu = new_cpu();
+    cpu.registers.sp = 0xD000;  // NOLINT
+
+    uint8_t program[] = {
+        0xCC, 0x10, 0x00,  // CALL Z, 0x0010
+        0xCD, 0x10, 0x00,  // CALL 0x0010
+        0x20, 0x02,        // JR NZ, 2
+        0xCB, 0x46,        // BIT 0, (HL)
+    };
+    load_program(&cpu, program, sizeof(program));
+    mem_write(&cpu, 0x10, 0xC0);  // RET NZ NOLINT
+
+    assert(step(&cpu) == 12);
+    assert(cpu.registers.pc == 0x0003);
+    assert(step(&cpu) == 24);
+    assert(cpu.registers.pc == 0x0010);
+    assert(step(&cpu) == 20);
+    assert(cpu.registers.pc == 0x0006);
+    assert(step(&cpu) == 12);
+    assert(cpu.registers.pc == 0x0008);
+    assert(step(&cpu) == 12);
+    assert(cpu.cycles == 12 + 24 + 20 + 12 + 12);
+    free_cpu(&cpu);
+}
+
+void test_run() {
+    CPU cpu = new_cpu();
+
+    uint8_t program[] = {
+        0x3E, 0x05,        // LD A, 5
+        0x06, 0x03,        // LD B, 3
+        0x80,              // ADD A, B
+        0x05,              // DEC B
+        0xC2, 0x04, 0x00,  // JP NZ, 0x0004
+    };
+    load_program(&cpu, program, sizeof(program));
+
+    // Taken JP NZ twice and falling through once
+    uint32_t cycles = 8 + 8 + (4 + 4 + 16) * 2 + (4 + 4 + 12);
+    assert(run_cycles(&cpu, cycles) == cycles);
+    assert(cpu.registers.a == 5 + 3 + 2 + 1);
+    assert(cpu.registers.b == 0);
+    assert(cpu.registers.pc == sizeof(program));
+
+    // Stop in front of the JP NZ of the first loop iteration
+    free_cpu(&cpu);
+    cpu = new_cpu();
+    load_program(&cpu, program, sizeof(program));
+    cpu.breakpoint = 0x0006;  // NOLINT
+    assert(run_cycles(&cpu, 1000) == 8 + 8 + 4 + 4);
+    assert(cpu.registers.pc == 0x0006);
+
+    // The rest of the frame runs into the NOPs after the program
+    cpu.breakpoint = NO_BREAKPOINT;
+    assert(run_frame(&cpu) == FRAME_CYCLES - (8 + 8 + 4 + 4));
+    assert(cpu.cycles == FRAME_CYCLES);
+    assert(run_cycles(&cpu, 0) == 0);
+    free_cpu(&cpu);
+}
+
+void test_self_modifying_code() {
+    CPU cpu = new_cpu();
+
+    uint8_t program[] = {
+        0x21, 0x05, 0x00,  // LD HL, 0x0005
+        0x36, 0x04,        // LD (HL), 0x04 (turns the INC A below into INC B)
+        0x3C,              // INC A
+        0xC3, 0x06, 0x00,  // JP 0x0006
+    };
+    load_program(&cpu, program, sizeof(program));
+
+    assert(run_cycles(&cpu, 12 + 12 + 4) == 12 + 12 + 4);
+    assert(cpu.registers.a == 0);
+    assert(cpu.registers.b == 1);
+    assert(cpu.registers.pc == 0x0006);
+    free_cpu(&cpu);
+
+    // Code in WRAM overwritten through echo RAM
+    cpu = new_cpu();
+    uint8_t wram_program[] = {
+        0x21, 0x05, 0xE0,  // LD HL, 0xE005
+        0x36, 0x04,        // LD (HL), 0x04
+        0x3C,              // INC A
+        0xC3, 0x06, 0xC0,  // JP 0xC006
+    };
+    cpu.registers.pc = WRAM_START;
+    load_program(&cpu, wram_program, sizeof(wram_program));
+    assert(run_cycles(&cpu, 12 + 12 + 4) == 12 + 12 + 4);
+    assert(cpu.registers.a == 0);
+    assert(cpu.registers.b == 1);
+    free_cpu(&cpu);
+}
+
+static uint64_t event_times[8];
+static uint8_t event_kinds[8];
+static int event_count;
+
+static void record_event(CPU *cpu, uint8_t kind, uint64_t time) {
+    assert(cpu->cycles == time);
+    event_kinds[event_count] = kind;
+    event_times[event_count] = time;
+    event_count++;
+}
+
+static void timer_event(CPU *cpu, uint64_t time) {
+    record_event(cpu, EVENT_TIMER, time);
+    if (time < 400) {
+        schedule_event(cpu, EVENT_TIMER, time + 100, timer_event);
+    }
+}
+
+static void serial_event(CPU *cpu, uint64_t time) { record_event(cpu, EVENT_SERIAL, time); }
+
+void test_scheduler() {
+    CPU cpu = new_cpu();
+
+    // Memory is all NOPs, so every event is hit on the exact cycle
+    schedule_event(&cpu, EVENT_TIMER, 100, timer_event);
+    schedule_event(&cpu, EVENT_SERIAL, 200, serial_event);
+    schedule_event(&cpu, EVENT_PPU, 40, serial_event);
+    schedule_event(&cpu, EVENT_SERIAL, 260, serial_event);
+    cancel_event(&cpu, EVENT_PPU);
+    assert(next_event(&cpu.scheduler) == 100);
+
+    assert(run_cycles(&cpu, 1000) == 1000);
+    uint8_t kinds[] = {EVENT_TIMER, EVENT_TIMER, EVENT_SERIAL, EVENT_TIMER, EVENT_TIMER};
+    uint64_t times[] = {100, 200, 260, 300, 400};
+    assert(event_count == 5);
+    for (int i = 0; i < event_count; i++) {
+        assert(event_kinds[i] == kinds[i]);
+        assert(event_times[i] == times[i]);
+    }
+    assert(next_event(&cpu.scheduler) == NO_EVENT);
+    free_cpu(&cpu);
+}
+
+/* The timer the slow way, ticked one cycle at a time */
+typedef struct {
+    uint16_t counter;
+    uint8_t tima;
+    uint8_t tma;
+    uint8_t tac;
+    uint8_t flags;
+} RefTimer;
+
+static bool ref_input(const RefTimer *timer) {
+    static const uint8_t bits[] = {9, 3, 5, 7};
+    return (timer->tac & TAC_ENABLE) && (timer->counter >> bits[timer->tac & TAC_CLOCK_M]) & 1;
+}
+
+static void ref_increment(RefTimer *timer) {
+    if (++timer->tima == 0) {
+        timer->tima = timer->tma;
+        timer->flags |= INT_TIMER;
+    }
+}
+
+static void ref_write(RefTimer *timer, uint16_t addr, uint8_t val) {
+    bool input = ref_input(timer);
+    if (addr == IO_DIV) {
+        timer->counter = 0;
+    } else if (addr == IO_TIMA) {
+        timer->tima = val;
+    } else if (addr == IO_TMA) {
+        timer->tma = val;
+    } else {
+        timer->tac = val & (TAC_ENABLE | TAC_CLOCK_M);
+    }
+    if (input && !ref_input(timer)) {
+        ref_increment(timer);
+    }
+}
+
+void test_timer() {
+    CPU cpu = new_cpu();
+    RefTimer ref = {0};
+
+    // Random writes at random times, including the ones that glitch TIMA
+    uint32_t seed = 7;  // NOLINT
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245 + 12345;  // NOLINT
+        uint32_t cycles = (seed >> 16) % 600;  // NOLINT
+        for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+            bool input = ref_input(&ref);
+            ref.counter++;
+            if (input && !ref_input(&ref)) {
+                ref_increment(&ref);
+            }
+        }
+        cpu.cycles += cycles;
+        run_events(&cpu);
+
+        assert(mem_read(&cpu, IO_DIV) == ref.counter >> BYTE_SIZE);
+        assert(mem_read(&cpu, IO_TIMA) == ref.tima);
+        assert(mem_read(&cpu, IO_IF) == (ref.flags | IF_UNUSED_M));
+        mem_write(&cpu, IO_IF, 0);
+        ref.flags = 0;
+
+        uint16_t addr = IO_DIV + (seed >> 8) % 4;  // NOLINT
+        uint8_t val = seed >> 24;                   // NOLINT
+        if ((seed & 0x7) == 0) {
+            mem_write(&cpu, addr, val);
+            ref_write(&ref, addr, val);
+        }
+    }
+    free_cpu(&cpu);
+
+    // TIMA overflows on its own while running, every 16 cycles with TAC 0x05
+    cpu = new_cpu();
+    mem_write(&cpu, IO_TMA, 0x80);
+    mem_write(&cpu, IO_TIMA, 0xF0);
+    mem_write(&cpu, IO_TAC, TAC_ENABLE | 0x01);
+    run_cycles(&cpu, 16 * 16);
+    assert(cpu.memory->high[IO_IF & BYTE_M] == INT_TIMER);
+    assert(mem_read(&cpu, IO_TIMA) == 0x80);
+    free_cpu(&cpu);
+}
+
+static int halt_reads;
+
+static uint8_t halt_read(CPU *cpu, uint16_t addr) {
+    (void)cpu;
+    (void)addr;
+    halt_reads++;
+    return 0x76;  // HALT NOLINT
+}
+
+void test_interrupts() {
+    CPU cpu = new_cpu();
+    cpu.registers.sp = 0xD000;  // NOLINT
+
+    mem_write(&cpu, 0x0000, 0xFB);  // EI NOLINT
+    mem_write(&cpu, 0x0040, 0xD9);  // RETI NOLINT
+    mem_write(&cpu, 0x0050, 0xD9);  // RETI NOLINT
+    mem_write(&cpu, IO_IE, INT_VBLANK | INT_TIMER);
+    request_interrupt(&cpu, INT_TIMER | INT_VBLANK);
+
+    // IME is only set after the instruction following EI
+    assert(step(&cpu) == 4);
+    assert(!cpu.ime);
+    assert(step(&cpu) == 4);
+    assert(cpu.ime);
+
+    // VBlank has the highest priority
+    assert(step(&cpu) == INT_DISPATCH_CYCLES);
+    assert(cpu.registers.pc == 0x0040);
+    assert(!cpu.ime);
+    assert(mem_read(&cpu, IO_IF) == (INT_TIMER | IF_UNUSED_M));
+    assert(mem_read(&cpu, cpu.registers.sp) == 0x02);
+
+    // RETI enables interrupts again right away
+    assert(step(&cpu) == 16);
+    assert(cpu.registers.pc == 0x0002);
+    assert(step(&cpu) == INT_DISPATCH_CYCLES);
+    assert(cpu.registers.pc == 0x0050);
+    step(&cpu);
+    assert(cpu.registers.sp == 0xD000);
+    free_cpu(&cpu);
+
+    // DI right after EI takes it back, RST calls its vector
+    cpu = new_cpu();
+    cpu.registers.sp = 0xD000;  // NOLINT
+    mem_write(&cpu, 0x0000, 0xFB);  // EI NOLINT
+    mem_write(&cpu, 0x0001, 0xF3);  // DI NOLINT
+    mem_write(&cpu, 0x0002, 0xEF);  // RST 0x28 NOLINT
+    mem_write(&cpu, IO_IE, INT_TIMER);
+    request_interrupt(&cpu, INT_TIMER);
+    step(&cpu);
+    step(&cpu);
+    assert(step(&cpu) == 16);
+    assert(!cpu.ime);
+    assert(cpu.registers.pc == 0x0028);
+    assert(mem_read(&cpu, cpu.registers.sp) == 0x03);
+    free_cpu(&cpu);
+
+    // An interrupt requested by a write is taken right after it, even inside of a block
+    uint8_t program[] = {
+        0xFB,        // EI
+        0x00,        // NOP
+        0x3E, 0x04,  // LD A, INT_TIMER
+        0xE0, 0x0F,  // LDH (IF), A
+        0x04,        // INC B
+        0x18, 0x00,  // JR 0
+    };
+    cpu = new_cpu();
+    cpu.registers.sp = 0xD000;  // NOLINT
+    load_program(&cpu, program, sizeof(program));
+    mem_write(&cpu, 0x0050, 0x48);  // LD C, B NOLINT
+    mem_write(&cpu, 0x0051, 0xD9);  // RETI NOLINT
+    mem_write(&cpu, IO_IE, INT_TIMER);
+    run_cycles(&cpu, 200);  // NOLINT
+    assert(cpu.registers.c == 0);
+    assert(cpu.registers.b == 1);
+    assert(cpu.registers.pc == 0x0007);
+    assert(cpu.ime);
+    free_cpu(&cpu);
+
+    // HALT waits for the timer, with IME set the interrupt is taken
+    uint8_t halt_program[] = {
+        0xFB,        // EI
+        0x76,        // HALT
+        0x18, 0x00,  // JR 0
+    };
+    cpu = new_cpu();
+    cpu.registers.sp = 0xD000;  // NOLINT
+    load_program(&cpu, halt_program, sizeof(halt_program));
+    mem_write(&cpu, 0x0050, 0x3C);  // INC A NOLINT
+    mem_write(&cpu, 0x0051, 0xD9);  // RETI NOLINT
+    mem_write(&cpu, IO_IE, INT_TIMER);
+    mem_write(&cpu, IO_TIMA, 0xFF);
+    mem_write(&cpu, IO_TAC, TAC_ENABLE | 0x01);
+    run_cycles(&cpu, 8);  // NOLINT
+    assert(cpu.halted);
+    assert(cpu.registers.pc == 0x0001);
+    run_cycles(&cpu, 1000);  // NOLINT
+    assert(!cpu.halted);
+    assert(cpu.registers.a == 1);
+    assert(cpu.registers.pc == 0x0002);
+    free_cpu(&cpu);
+
+    // Halted, a whole frame takes a handful of HALTs
+    cpu = new_cpu();
+    map_handlers(&cpu, 0, 1, halt_read, NULL);
+    halt_reads = 0;
+    assert(run_frame(&cpu) == FRAME_CYCLES);
+    assert(cpu.halted);
+    assert(cpu.registers.pc == 0x0000);
+    assert(halt_reads < 10);  // NOLINT
+    free_cpu(&cpu);
+
+    // With IME clear, HALT only waits and the interrupt stays requested
+    cpu = new_cpu();
+    mem_write(&cpu, 0x0000, 0x76);  // HALT NOLINT
+    mem_write(&cpu, 0x0001, 0x04);  // INC B NOLINT
+    mem_write(&cpu, IO_IE, INT_TIMER);
+    run_cycles(&cpu, 100);  // NOLINT
+    assert(cpu.halted);
+    assert(cpu.registers.b == 0);
+    request_interrupt(&cpu, INT_TIMER);
+    run_cycles(&cpu, 8);  // NOLINT
+    assert(!cpu.halted);
+    assert(cpu.registers.b == 1);
+    assert(mem_read(&cpu, IO_IF) == (INT_TIMER | IF_UNUSED_M));
+    free_cpu(&cpu);
+}
+
+/* Runs a loop often enough for DISPATCH=dynarec to compile it */
+void test_hot_loop() {
+    CPU cpu = new_cpu();
+
+    uint8_t program[] = {
+        0x01, 0x00, 0x00,  // LD BC, 0x0000
+        0x31, 0x00, 0xD0,  // LD SP, 0xD000
+        0x16, 0x64,        // LD D, 100
+        0x7A,              // LD A, D
+        0x5F,              // LD E, A
+        0x03,              // INC BC
+        0x3B,              // DEC SP
+        0x83,              // ADD A, E
+        0x67,              // LD H, A
+        0x15,              // DEC D
+        0xC2, 0x08, 0x00,  // JP NZ, 0x0008
+    };
+    load_program(&cpu, program, sizeof(program));
+
+    uint32_t loop = 4 + 4 + 8 + 8 + 4 + 4 + 4 + 16;
+    uint32_t cycles = 12 + 12 + 8 + loop * 100 - 4;
+    assert(run_cycles(&cpu, cycles) == cycles);
+    assert(cpu.registers.pc == sizeof(program));
+    assert(cpu.registers.bc == 100);
+    assert(cpu.registers.sp == 0xD000 - 100);
+    assert(cpu.registers.d == 0);
+    assert(cpu.registers.e == 1);
+    assert(cpu.registers.h == 2);
+    free_cpu(&cpu);
+}
+
+/* The flags of INC, ADD and SUB are overwritten before the JR reads them */
+void test_dead_flags() {
+    CPU cpu = new_cpu();
+
+    uint8_t program[] = {
+        0x3E, 0x01,  // LD A, 1
+        0x06, 0x02,  // LD B, 2
+        0x04,        // INC B
+        0x80,        // ADD A, B
+        0xD6, 0x01,  // SUB 1
+        0xFE, 0x03,  // CP 3
+        0x28, 0x02,  // JR Z, 2
+    };
+    load_program(&cpu, program, sizeof(program));
+
+    uint32_t cycles = 8 + 8 + 4 + 4 + 8 + 8 + 12;
+    assert(run_cycles(&cpu, cycles) == cycles);
+    assert(cpu.registers.pc == sizeof(program));
+    assert(cpu.registers.a == 3);
+    assert(cpu.registers.b == 3);
+    assert(get_reg(&cpu, F) == BIN(0b11000000));
+
+    // Stopping halfway through still leaves the flags of the last instruction
+    free_cpu(&cpu);
+    cpu = new_cpu();
+    load_program(&cpu, program, sizeof(program));
+    assert(run_cycles(&cpu, 8 + 8 + 4) == 8 + 8 + 4);
+    assert(cpu.registers.b == 3);
+    assert(get_reg(&cpu, F) == BIN(0b00000000));
+    free_cpu(&cpu);
+}
+
+/* Copies 4 bytes with the LD A, (HL+) / LD (DE), A / INC DE / DEC B / JR NZ idiom */
+void test_copy_loop() {
+    CPU cpu = new_cpu();
+
+    uint8_t program[] = {
+        0x21, 0x00, 0xC0,  // LD HL, 0xC000
+        0x11, 0x00, 0xD0,  // LD DE, 0xD000
+        0x06, 0x04,        // LD B, 4
+        0x2A,              // LD A, (HL+)
+        0x12,              // LD (DE), A
+        0x13,              // INC DE
+        0x05,              // DEC B
+        0x20, 0xFC,        // JR NZ, -4
+    };
+    load_program(&cpu, program, sizeof(program));
+    for (uint16_t i = 0; i < 4; i++) {
+        mem_write(&cpu, 0xC000 + i, 0x10 + i);  // NOLINT
+    }
+
+    // JR jumps relative to its own address, so -4 lands on LD A, (HL+)
+    uint32_t loop = 8 + 8 + 8 + 4 + 8;
+    uint32_t cycles = 12 + 12 + 8 + loop * 4 + 4 * 3;
+    assert(run_cycles(&cpu, cycles) == cycles);
+    assert(cpu.registers.pc == sizeof(program));
+    assert(cpu.registers.b == 0);
+    assert(cpu.registers.hl == 0xC004);
+    assert(cpu.registers.de == 0xD004);
+    for (uint16_t i = 0; i < 4; i++) {
+        assert(mem_read(&cpu, 0xD000 + i) == 0x10 + i);  // NOLINT
+    }
+
+    // Stopping in the middle of an iteration
+    free_cpu(&cpu);
+    cpu = new_cpu();
+    load_program(&cpu, program, sizeof(program));
+    uint32_t partial = 12 + 12 + 8 + (loop + 4) + 8 + 8;
+    assert(run_cycles(&cpu, partial) == partial);
+    assert(cpu.registers.pc == 0x000A);
+    assert(cpu.registers.de == 0xD001);
+    free_cpu(&cpu);
 }
 
-int main() {
+static uint8_t io_regs[PAGE_SIZE];
+static int io_writes;
+
+static uint8_t fake_io_read(CPU *cpu, uint16_t addr) {
+    (void)cpu;
+    return io_regs[addr & BYTE_M] ^ BYTE_M;
+}
+
+static void fake_io_write(CPU *cpu, uint16_t addr, uint8_t val) {
+    (void)cpu;
+    io_regs[addr & BYTE_M] = val;
+    io_writes++;
+}
+
+void test_bus() {
+    CPU cpu = new_cpu();
+
+    uint8_t program[] = {
+        0x3E, 0x42,        // LD A, 0x42
+        0xE0, 0x40,        // LDH (0x40), A
+        0xF0, 0x40,        // LDH A, (0x40)
+        0x21, 0x00, 0x10,  // LD HL, 0x1000
+        0x77,              // LD (HL), A
+        0x46,              // LD B, (HL)
+    };
+    load_program(&cpu, program, sizeof(program));
+
+    // Read-only ROM and an I/O page that goes through handlers
+    map_pages(&cpu, 0x00, 0x80, cpu.memory->rom, NULL);
+    map_handlers(&cpu, 0xFF, 1, fake_io_read, fake_io_write);
+
+    uint32_t cycles = 8 + 12 + 12 + 12 + 8 + 8;
+    assert(run_cycles(&cpu, cycles) == cycles);
+    assert(io_writes == 1);
+    assert(io_regs[0x40] == 0x42);
+    assert(cpu.memory->high[0x40] == 0);
+    assert(cpu.registers.a == (0x42 ^ BYTE_M));
+    assert(mem_read(&cpu, 0x1000) == 0);
+    assert(cpu.registers.b == 0);
+    free_cpu(&cpu);
+}
+
+void test_memory_map() {
+    CPU cpu = new_cpu();
+
+    // Echo RAM mirrors WRAM both ways, as plain memory
+    assert(cpu.memory->bus.read_pages[0xE0] == cpu.memory->wram);
+    assert(cpu.memory->bus.write_pages[0xFD] == cpu.memory->wram + 0x1D00);
+    mem_write(&cpu, 0xE010, 0x5A);
+    assert(mem_read(&cpu, 0xC010) == 0x5A);
+    assert(cpu.memory->wram[0x10] == 0x5A);
+    mem_write(&cpu, 0xDDFF, 0xA5);
+    assert(mem_read(&cpu, 0xFDFF) == 0xA5);
+
+    // The last byte of the address space is IE
+    mem_write(&cpu, 0xFFFF, 0x1F);
+    assert(mem_read(&cpu, 0xFFFF) == 0x1F);
+    assert(cpu.memory->high[0xFF] == 0x1F);
+
+    mem_write(&cpu, 0x9800, 0x01);
+    mem_write(&cpu, 0xA000, 0x02);
+    mem_write(&cpu, 0xFE00, 0x03);
+    assert(cpu.memory->vram[0x1800] == 0x01);
+    assert(cpu.memory->sram[0] == 0x02);
+    assert(cpu.memory->oam[0] == 0x03);
+    free_cpu(&cpu);
+}
+
+/* Writes rom to a temporary file, whose path ends up in path */
+static void write_rom(char *path, const uint8_t *rom, size_t size) {
+    strcpy(path, "/tmp/kogaboy_XXXXXX");
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    assert(write(fd, rom, size) == (ssize_t)size);
+    close(fd);
+}
+
+void test_cartridge() {
+    static uint8_t rom[4 * ROM_BANK_SIZE];
+    memcpy(rom + HEADER_TITLE, "KOGABOY", 7);
+    rom[HEADER_ROM_SIZE] = 1;  // 64 KiB
+    uint8_t program[] = {
+        0xFA, 0x00, 0x40,  // LD A, (0x4000)
+        0xEA, 0x00, 0x20,  // LD (0x2000), A
+    };
+    memcpy(rom + 0x0100, program, sizeof(program));
+    rom[0x4000] = 0x99;  // NOLINT
+    for (uint16_t addr = HEADER_TITLE; addr < HEADER_CHECKSUM; addr++) {
+        rom[HEADER_CHECKSUM] = rom[HEADER_CHECKSUM] - rom[addr] - 1;
+    }
+
+    char path[32];
+    write_rom(path, rom, sizeof(rom));
+    Cartridge *cart = load_cartridge(path);
+    assert(cart != NULL);
+    assert(strcmp(cart->title, "KOGABOY") == 0);
+    assert(cart->rom_banks == 4);
+    assert(cart->ram_banks == 0);
+
+    // Both CPUs read the same mapping
+    CPU cpu = new_cpu();
+    CPU other = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    assert(insert_cartridge(&other, cart));
+    assert(cpu.memory->bus.read_pages[0] == cart->rom);
+    assert(other.memory->bus.read_pages[0] == cart->rom);
+
+    // ROM can't be written
+    cpu.registers.pc = 0x0100;  // NOLINT
+    assert(run_cycles(&cpu, 16 + 16) == 16 + 16);
+    assert(cpu.registers.a == 0x99);
+    assert(mem_read(&cpu, 0x2000) == 0);
+    assert(mem_read(&other, 0x0100) == 0xFA);
+    free_cpu(&cpu);
+    free_cpu(&other);
+    free_cartridge(cart);
+    unlink(path);
+
+    // Neither can a ROM with a broken header
+    rom[HEADER_CHECKSUM] ^= 1;
+    write_rom(path, rom, sizeof(rom));
+    assert(load_cartridge(path) == NULL);
+    unlink(path);
+}
+
+/* Fills in the header fields load_cartridge() checks */
+static void set_header(uint8_t *rom, uint8_t type, uint8_t rom_size, uint8_t ram_size) {
+    rom[HEADER_TYPE] = type;
+    rom[HEADER_ROM_SIZE] = rom_size;
+    rom[HEADER_RAM_SIZE] = ram_size;
+    rom[HEADER_CHECKSUM] = 0;
+    for (uint16_t addr = HEADER_TITLE; addr < HEADER_CHECKSUM; addr++) {
+        rom[HEADER_CHECKSUM] = rom[HEADER_CHECKSUM] - rom[addr] - 1;
+    }
+}
+
+void test_mbc() {
+    static uint8_t rom[8 * ROM_BANK_SIZE];
+    uint8_t program[] = {
+        0xCD, 0x00, 0x40,  // CALL 0x4000
+        0x47,              // LD B, A
+        0x3E, 0x05,        // LD A, 5
+        0xEA, 0x00, 0x20,  // LD (0x2000), A
+        0xCD, 0x00, 0x40,  // CALL 0x4000
+    };
+    uint8_t bank_loop[] = {
+        0x3E, 0x0A,        // LD A, 0x0A
+        0xEA, 0x00, 0x00,  // LD (0x0000), A
+        0x21, 0x00, 0xA0,  // LD HL, 0xA000
+        0x06, 0x40,        // LD B, 0x40
+        0x78,              // LD A, B
+        0xEA, 0x00, 0x20,  // LD (0x2000), A
+        0xFA, 0x01, 0x40,  // LD A, (0x4001)
+        0x22,              // LD (HL+), A
+        0x05,              // DEC B
+        0xC2, 0x0A, 0x02,  // JP NZ, 0x020A
+    };
+    memcpy(rom + 0x0150, program, sizeof(program));
+    memcpy(rom + 0x0200, bank_loop, sizeof(bank_loop));
+    // Every bank has a function at 0x4000 returning its number in A
+    for (uint8_t bank = 1; bank < 8; bank++) {
+        rom[bank * ROM_BANK_SIZE] = 0x3E;  // LD A, bank
+        rom[bank * ROM_BANK_SIZE + 1] = bank;
+        rom[bank * ROM_BANK_SIZE + 2] = 0xC9;  // RET
+    }
+    set_header(rom, 0x03, 2, 3);  // MBC1+RAM+BATTERY, 128 KiB ROM, 32 KiB RAM
+
+    char path[32];
+    write_rom(path, rom, sizeof(rom));
+    Cartridge *cart = load_cartridge(path);
+    assert(cart != NULL);
+    assert(cart->mbc == MBC_1);
+
+    // The same address runs code of whatever bank is mapped
+    CPU cpu = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    cpu.registers.pc = 0x0150;  // NOLINT
+    cpu.registers.sp = 0xFFFE;  // NOLINT
+    cpu.breakpoint = 0x0150 + sizeof(program);
+    run_cycles(&cpu, 1000);  // NOLINT
+    assert(cpu.registers.pc == cpu.breakpoint);
+    assert(cpu.registers.b == 1);
+    assert(cpu.registers.a == 5);
+
+    // Bank 0 turns into bank 1, bank numbers wrap at the ROM size
+    mem_write(&cpu, 0x2000, 0x00);
+    assert(mem_read(&cpu, 0x4001) == 1);
+    mem_write(&cpu, 0x2000, 0x0B);
+    assert(mem_read(&cpu, 0x4001) == 3);
+
+    // RAM reads as open bus until it's enabled, and is banked in mode 1
+    assert(mem_read(&cpu, 0xA000) == 0xFF);
+    mem_write(&cpu, 0x0000, 0x0A);
+    mem_write(&cpu, 0xA000, 0x11);
+    mem_write(&cpu, 0x6000, 0x01);
+    mem_write(&cpu, 0x4000, 0x02);
+    assert(mem_read(&cpu, 0xA000) == 0);
+    mem_write(&cpu, 0xA000, 0x22);
+    mem_write(&cpu, 0x4000, 0x00);
+    assert(mem_read(&cpu, 0xA000) == 0x11);
+    mem_write(&cpu, 0x0000, 0x00);
+    assert(mem_read(&cpu, 0xA000) == 0xFF);
+
+    // A hot loop switching banks and writing RAM, which DYNAREC_VERIFY
+    // checks against the interpreter on its own copy of the MBC
+    free_cpu(&cpu);
+    cpu = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    cpu.registers.pc = 0x0200;  // NOLINT
+    cpu.breakpoint = 0x0200 + sizeof(bank_loop);
+    run_cycles(&cpu, 10000);  // NOLINT
+    assert(cpu.registers.pc == cpu.breakpoint);
+    for (uint8_t i = 0; i < 0x40; i++) {
+        uint8_t bank = (0x40 - i) & 0x1F;
+        assert(mem_read(&cpu, 0xA000 + i) == ((bank != 0 ? bank : 1) & 0x07));
+    }
+    free_cpu(&cpu);
+    free_cartridge(cart);
+    unlink(path);
+
+    // MBC2 RAM only keeps the lower nibble and repeats every 512 bytes
+    set_header(rom, 0x06, 2, 0);  // MBC2+BATTERY
+    write_rom(path, rom, sizeof(rom));
+    cart = load_cartridge(path);
+    assert(cart != NULL);
+    cpu = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    mem_write(&cpu, 0x0000, 0x0A);
+    mem_write(&cpu, 0xA005, 0xA5);
+    assert(mem_read(&cpu, 0xA205) == 0xF5);
+    mem_write(&cpu, 0x0100, 0x07);
+    assert(mem_read(&cpu, 0x4001) == 7);
+
+    // Code running from MBC2 RAM sees writes to any of its repeats
+    uint8_t ram_code[] = {
+        0xF3,  // DI
+        0xF3,  // DI
+        0xFF,  // RST 0x38
+    };
+    for (uint16_t i = 0; i < sizeof(ram_code); i++) {
+        mem_write(&cpu, 0xA000 + i, ram_code[i]);
+    }
+    mem_write(&cpu, 0xFFF4, 0x44);
+    cpu.registers.c = 0xF4;  // NOLINT
+    cpu.breakpoint = 0x0038;
+    for (int i = 0; i < 20; i++) {  // NOLINT
+        cpu.registers.a = 0;
+        cpu.registers.pc = 0xA000;  // NOLINT
+        cpu.registers.sp = 0xFFFE;  // NOLINT
+        run_cycles(&cpu, 100);      // NOLINT
+        assert(cpu.registers.pc == cpu.breakpoint);
+        assert(cpu.registers.a == 0);
+    }
+    mem_write(&cpu, 0xA200, 0xF2);  // LD A, (C)
+    cpu.registers.pc = 0xA000;      // NOLINT
+    cpu.registers.sp = 0xFFFE;      // NOLINT
+    run_cycles(&cpu, 100);          // NOLINT
+    assert(cpu.registers.pc == cpu.breakpoint);
+    assert(cpu.registers.a == 0x44);
+    free_cpu(&cpu);
+    free_cartridge(cart);
+    unlink(path);
+}
+
+void test_save() {
+    static uint8_t rom[2 * ROM_BANK_SIZE];
+    set_header(rom, 0x03, 0, 2);  // MBC1+RAM+BATTERY, 32 KiB ROM, 8 KiB RAM
+    char rom_path[32];
+    char save_path[32];
+    write_rom(rom_path, rom, sizeof(rom));
+    write_rom(save_path, rom, 0);
+    Cartridge *cart = load_cartridge(rom_path);
+    assert(cart != NULL);
+    assert(cart->battery);
+
+    CPU cpu = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    assert(attach_save(&cpu, save_path));
+    mem_write(&cpu, 0x0000, 0x0A);
+    assert(cpu.memory->bus.write_pages[0xA0] == NULL);
+
+    // Only the first write to a page is caught
+    mem_write(&cpu, 0xA010, 0x42);
+    assert(cpu.mbc->dirty[0]);
+    assert(!cpu.mbc->dirty[1]);
+    assert(cpu.memory->bus.write_pages[0xA0] == cpu.mbc->ram);
+    assert(cpu.memory->bus.write_pages[0xA1] == NULL);
+
+    assert(flush_save(&cpu));
+    assert(!cpu.mbc->dirty[0]);
+    assert(cpu.memory->bus.write_pages[0xA0] == NULL);
+
+    // Pages that weren't flushed yet are on shutdown
+    mem_write(&cpu, 0xA110, 0x43);
+    free_cpu(&cpu);
+
+    cpu = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    assert(attach_save(&cpu, save_path));
+    mem_write(&cpu, 0x0000, 0x0A);
+    assert(mem_read(&cpu, 0xA010) == 0x42);
+    assert(mem_read(&cpu, 0xA110) == 0x43);
+    free_cpu(&cpu);
+    free_cartridge(cart);
+    unlink(rom_path);
+    unlink(save_path);
+}
+
+/* Latches the MBC3 clock and reads one of its registers */
+static uint8_t read_rtc(CPU *cpu, uint8_t reg) {
+    mem_write(cpu, 0x6000, 0x00);
+    mem_write(cpu, 0x6000, 0x01);
+    mem_write(cpu, 0x4000, reg);
+    return mem_read(cpu, 0xA000);
+}
+
+void test_rtc() {
+    static uint8_t rom[2 * ROM_BANK_SIZE];
+    set_header(rom, 0x10, 0, 2);  // MBC3+TIMER+RAM+BATTERY
+    char path[32];
+    write_rom(path, rom, sizeof(rom));
+    Cartridge *cart = load_cartridge(path);
+    assert(cart != NULL);
+
+    CPU cpu = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    set_rtc_clock(&cpu, true);
+    mem_write(&cpu, 0x0000, 0x0A);
+
+    // The clock only moves with the emulated cycles, and only when latched
+    cpu.cycles += 61 * CLOCK_HZ + CLOCK_HZ / 2;
+    assert(read_rtc(&cpu, RTC_SECONDS) == 1);
+    assert(read_rtc(&cpu, RTC_MINUTES) == 1);
+    cpu.cycles += CLOCK_HZ / 2;
+    assert(read_rtc(&cpu, RTC_SECONDS) == 2);
+
+    // A halted clock stands still
+    mem_write(&cpu, 0x4000, RTC_DAYS_HIGH);
+    mem_write(&cpu, 0xA000, RTC_HALT);
+    cpu.cycles += 10 * CLOCK_HZ;  // NOLINT
+    assert(read_rtc(&cpu, RTC_SECONDS) == 2);
+    assert(read_rtc(&cpu, RTC_DAYS_HIGH) == RTC_HALT);
+
+    // Day 511 runs over into the carry
+    mem_write(&cpu, 0x4000, RTC_DAYS_LOW);
+    mem_write(&cpu, 0xA000, 0xFF);
+    mem_write(&cpu, 0x4000, RTC_DAYS_HIGH);
+    mem_write(&cpu, 0xA000, 0x01);
+    cpu.cycles += (uint64_t)24 * 60 * 60 * CLOCK_HZ;  // NOLINT
+    assert(read_rtc(&cpu, RTC_DAYS_LOW) == 0);
+    assert(read_rtc(&cpu, RTC_DAYS_HIGH) == RTC_CARRY);
+
+    // Writing the minutes keeps the running second, writing the seconds restarts it
+    cpu.cycles += CLOCK_HZ / 2;
+    mem_write(&cpu, 0x4000, RTC_MINUTES);
+    mem_write(&cpu, 0xA000, 5);  // NOLINT
+    cpu.cycles += CLOCK_HZ / 2;
+    assert(read_rtc(&cpu, RTC_SECONDS) == 3);
+    assert(read_rtc(&cpu, RTC_MINUTES) == 5);
+    cpu.cycles += CLOCK_HZ / 2;
+    mem_write(&cpu, 0x4000, RTC_SECONDS);
+    mem_write(&cpu, 0xA000, 62);  // NOLINT
+    cpu.cycles += CLOCK_HZ / 2;
+    assert(read_rtc(&cpu, RTC_SECONDS) == 62);
+
+    // Seconds past 59 count up to 63 and wrap to 0 without carrying into the minutes
+    cpu.cycles += 2 * CLOCK_HZ;
+    assert(read_rtc(&cpu, RTC_SECONDS) == 0);
+    assert(read_rtc(&cpu, RTC_MINUTES) == 5);
+
+    // RAM banks are still there
+    mem_write(&cpu, 0x4000, 0x00);
+    mem_write(&cpu, 0xA000, 0x12);
+    assert(mem_read(&cpu, 0xA000) == 0x12);
+    free_cpu(&cpu);
+    free_cartridge(cart);
+    unlink(path);
+}
+
+#ifdef FASTMEM
+/* Every address has to read the same through the mirror and the bus */
+static void assert_mirrored(CPU *cpu) {
+    for (uint32_t addr = 0; addr < MEMORY_SIZE; addr++) {
+        assert(mem_read(cpu, addr) == bus_read(cpu, addr));
+    }
+}
+
+void test_fastmem() {
+    CPU cpu = new_cpu();
+    assert(cpu.fastmem != NULL);
+    assert(((uintptr_t)cpu.fastmem & (MEMORY_SIZE - 1)) == 0);
+    // The last window mixes echo RAM, OAM and I/O
+    assert(cpu.fast_reads == 0x7FFF);
+    assert(cpu.fast_writes == 0x7FFF);
+    mem_write(&cpu, 0xE123, 0x42);
+    assert(cpu.memory->wram[0x123] == 0x42);
+    assert(mem_read(&cpu, 0xC123) == 0x42);
+    assert(cpu.fastmem[0xE123] == 0x42);
+    free_cpu(&cpu);
+
+    static uint8_t rom[8 * ROM_BANK_SIZE];
+    for (uint32_t addr = 0; addr < sizeof(rom); addr++) {
+        rom[addr] = addr * 7 + addr / ROM_BANK_SIZE;  // NOLINT
+    }
+    set_header(rom, 0x03, 2, 3);  // MBC1+RAM+BATTERY, 128 KiB ROM, 32 KiB RAM
+    char rom_path[32];
+    char save_path[32];
+    write_rom(rom_path, rom, sizeof(rom));
+    write_rom(save_path, rom, 0);
+    Cartridge *cart = load_cartridge(rom_path);
+    assert(cart != NULL);
+
+    // Random writes all over the address space switch banks, enable RAM,
+    // dirty pages of the save file and so on
+    cpu = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    assert_mirrored(&cpu);
+    assert(attach_save(&cpu, save_path));
+
+    // A window of the save file is written directly once all of its pages are dirty
+    mem_write(&cpu, 0x0000, 0x0A);
+    assert(cpu.fast_reads & (1 << 0xA));
+    for (uint16_t addr = 0xA000; addr < 0xB000; addr += PAGE_SIZE) {
+        assert(!(cpu.fast_writes & (1 << 0xA)));
+        mem_write(&cpu, addr, addr >> BYTE_SIZE);
+    }
+    assert(cpu.fast_writes & (1 << 0xA));
+    mem_write(&cpu, 0xA001, 0x01);
+    assert(cpu.mbc->ram[1] == 0x01);
+    assert(flush_save(&cpu));
+    assert(!(cpu.fast_writes & (1 << 0xA)));
+
+    uint32_t seed = 1;
+    for (int i = 0; i < 4096; i++) {
+        seed = seed * 1103515245 + 12345;  // NOLINT
+        uint16_t addr = seed >> 16;        // NOLINT
+        uint8_t val = seed >> 8;           // NOLINT
+        // RAM enable needs a specific value
+        if (addr < 0x2000 && (val & 1)) {
+            val = 0x0A;
+        }
+        mem_write(&cpu, addr, val);
+        assert(mem_read(&cpu, addr) == bus_read(&cpu, addr));
+        if (i % 256 == 0) {
+            assert_mirrored(&cpu);
+            flush_save(&cpu);
+        }
+    }
+    assert_mirrored(&cpu);
+    free_cpu(&cpu);
+    free_cartridge(cart);
+    unlink(rom_path);
+    unlink(save_path);
+}
+#endif
+
+#ifdef AOT
+static int aot_runs;
+
+/* What kogaboy-aot writes for ADD A, B; DEC B; JP NZ, 0x0004 */
+static void aot_loop(CPU *cpu) {
+    aot_runs++;
+    cpu->cycles += 4;
+    cpu->registers.pc = op_0x80(cpu);
+    cpu->cycles += 4;
+    cpu->registers.pc = op_0x05(cpu);
+    cpu->cycles += 12;
+    cpu->registers.pc = op_0xC2(cpu);
+}
+
+static AotBlock aot_blocks[AOT_ROM_SIZE];
+
+void test_aot() {
+    uint8_t program[] = {
+        0x3E, 0x05,        // LD A, 5
+        0x06, 0x03,        // LD B, 3
+        0x80,              // ADD A, B
+        0x05,              // DEC B
+        0xC2, 0x04, 0x00,  // JP NZ, 0x0004
+    };
+    aot_blocks[0x0004] = (AotBlock){aot_loop, 0x0009, 4 + 4 + 12};
+    AotModule module = {AOT_ABI_VERSION, sizeof(CPU), AOT_BUILD_FLAGS, 0, aot_blocks};
+    uint32_t cycles = 8 + 8 + (4 + 4 + 16) * 2 + (4 + 4 + 12);
+
+    CPU cpu = new_cpu();
+    load_program(&cpu, program, sizeof(program));
+    assert(!attach_aot(&cpu, &module, NULL));
+    module.rom_checksum = aot_checksum(cpu.memory->rom);
+    assert(attach_aot(&cpu, &module, NULL));
+
+    assert(run_cycles(&cpu, cycles) == cycles);
+    assert(cpu.registers.a == 5 + 3 + 2 + 1);
+    assert(cpu.registers.pc == sizeof(program));
+    // The first iteration belongs to the interpreted block starting at 0x0000
+    assert(aot_runs == 2);
+
+    // A breakpoint inside the block leaves it to the interpreter
+    free_cpu(&cpu);
+    cpu = new_cpu();
+    load_program(&cpu, program, sizeof(program));
+    assert(attach_aot(&cpu, &module, NULL));
+    cpu.breakpoint = 0x0006;  // NOLINT
+    assert(run_cycles(&cpu, 1000) == 8 + 8 + 4 + 4);
+    assert(cpu.registers.pc == 0x0006);
+    assert(aot_runs == 2);
+
+    // So does writing to the ROM page the block was compiled from
+    cpu.breakpoint = NO_BREAKPOINT;
+    mem_write(&cpu, 0x0000, 0x3E);
+    assert(run_cycles(&cpu, cycles - 24) == cycles - 24);
+    assert(cpu.registers.a == 5 + 3 + 2 + 1);
+    assert(cpu.registers.pc == sizeof(program));
+    assert(aot_runs == 2);
+    free_cpu(&cpu);
+}
+
+/* A ROM for make test-aot, which compiles it with kogaboy-aot. It takes
+ * timer interrupts while calling, jumping and writing memory in loops.
+ */
+static void write_aot_rom(const char *path) {
+    static uint8_t rom[2 * ROM_BANK_SIZE];
+    uint8_t rst_0x08[] = {
+        0x1C,  // INC E
+        0xC9,  // RET
+    };
+    uint8_t timer[] = {
+        0xF5,  // PUSH AF
+        0x14,  // INC D
+        0xF1,  // POP AF
+        0xD9,  // RETI
+    };
+    uint8_t entry[] = {
+        0x00,              // NOP
+        0xC3, 0x50, 0x01,  // JP 0x0150
+    };
+    uint8_t program[] = {
+        0x31, 0xFE, 0xFF,  // LD SP, 0xFFFE
+        0x3E, 0x04,        // LD A, 0x04
+        0xE0, 0xFF,        // LDH (IE), A
+        0x3E, 0x05,        // LD A, 0x05
+        0xE0, 0x07,        // LDH (TAC), A
+        0x21, 0x00, 0xC0,  // LD HL, 0xC000
+        0xFB,              // EI
+        0x06, 0x20,        // 0x015F: LD B, 0x20
+        0x78,              // 0x0161: LD A, B
+        0x80,              // ADD A, B
+        0x22,              // LD (HL+), A
+        0xCB, 0x37,        // SWAP A
+        0xCD, 0x00, 0x02,  // CALL 0x0200
+        0x05,              // DEC B
+        0x20, 0xF7,        // JR NZ, 0x0161
+        0x21, 0x00, 0xC0,  // LD HL, 0xC000
+        0xCF,              // RST 0x08
+        0x7B,              // LD A, E
+        0xFE, 0x40,        // CP 0x40
+        0x20, 0xEC,        // JR NZ, 0x015F
+        0x76,              // 0x0175: HALT
+        0x18, 0xFF,        // JR 0x0175
+    };
+    uint8_t subroutine[] = {
+        0x4F,              // LD C, A
+        0x81,              // ADD A, C
+        0xEA, 0x00, 0xD0,  // LD (0xD000), A
+        0xC9,              // RET
+    };
+    memcpy(rom + 0x0008, rst_0x08, sizeof(rst_0x08));
+    memcpy(rom + INT_VECTORS + 2 * INT_VECTOR_SIZE, timer, sizeof(timer));
+    memcpy(rom + 0x0100, entry, sizeof(entry));
+    memcpy(rom + HEADER_END, program, sizeof(program));
+    memcpy(rom + 0x0200, subroutine, sizeof(subroutine));
+    set_header(rom, 0x00, 0, 0);  // ROM only, 32 KiB
+
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    assert(fwrite(rom, 1, sizeof(rom), file) == sizeof(rom));
+    fclose(file);
+}
+
+static void assert_same_state(CPU *cpu, CPU *ref) {
+    assert(cpu->cycles == ref->cycles);
+    assert(cpu->registers.pc == ref->registers.pc);
+    assert(cpu->registers.sp == ref->registers.sp);
+    for (enum RegisterName reg = A; reg <= L; reg++) {
+        assert(get_reg(cpu, reg) == get_reg(ref, reg));
+    }
+    assert(cpu->ime == ref->ime);
+    assert(memcmp(cpu->memory->wram, ref->memory->wram, WRAM_SIZE) == 0);
+    assert(memcmp(cpu->memory->high, ref->memory->high, PAGE_SIZE) == 0);
+}
+
+/* Runs the image make test-aot compiled from write_aot_rom()'s ROM
+ * side by side with the interpreter.
+ */
+static void test_aot_image(const char *rom_path, const char *image_path) {
+    Cartridge *cart = load_cartridge(rom_path);
+    assert(cart != NULL);
+    CPU cpu = new_cpu();
+    CPU ref = new_cpu();
+    assert(insert_cartridge(&cpu, cart));
+    assert(insert_cartridge(&ref, cart));
+    cpu.registers.pc = 0x0100;
+    ref.registers.pc = 0x0100;
+    assert(load_aot(&cpu, image_path));
+    assert(cpu.aot->module->blocks[0x0161].run != NULL);  // NOLINT
+
+    for (int frame = 0; frame < 8; frame++) {  // NOLINT
+        run_frame(&cpu);
+        run_frame(&ref);
+        assert_same_state(&cpu, &ref);
+    }
+    assert(cpu.registers.e == 0x40);
+    assert(cpu.registers.d > 0);
+    assert(cpu.halted);
+
+    free_cpu(&cpu);
+    free_cpu(&ref);
+    free_cartridge(cart);
+}
+#endif
+
+void test_inst_lengths() {
+    for (uint16_t opcode = 0; opcode < OPCODE_COUNT; opcode++) {
+        enum InstructionKind kind = inst_table[opcode].kind;
+        if (opcode == PREFIX_BYTE || kind == JP || kind == JP_HL || kind == JR || kind == CALL ||
+            kind == RET || kind == RETI || kind == RST || kind == HALT || kind == STOP) {
+            continue;
+        }
+
+        CPU cpu = new_cpu();
+        cpu.registers.sp = 0xD000;    // NOLINT
+        cpu.registers.pc = 0x1000;    // NOLINT
+        mem_write(&cpu, 0x1000, opcode);  // NOLINT
+        step(&cpu);
+        assert(cpu.registers.pc == 0x1000 + inst_lengths[opcode]);
+        free_cpu(&cpu);
+    }
+}
+
+void test_flags() {
+    CPU cpu = new_cpu();
+    cpu.registers.sp = 0xD000;  // NOLINT
+
+    uint8_t program[] = {
+        0x3E, 0xFF,        // LD A, 0xFF
+        0xC6, 0x01,        // ADD A, 1
+        0x38, 0x02,        // JR C, 2
+        0x00,              // NOP
+        0x00,              // NOP
+        0x3C,              // INC A
+        0xCE, 0x00,        // ADC A, 0
+        0xF5,              // PUSH AF
+    };
+    load_program(&cpu, program, sizeof(program));
+
+    step(&cpu);
+    step(&cpu);
+    step(&cpu);
+    // JR jumps relative to its own address
+    assert(cpu.registers.pc == 0x0006);
+    assert(get_reg(&cpu, F) == BIN(0b10110000));
+
+    cpu.registers.pc = 0x0008;  // NOLINT
+    step(&cpu);
+    step(&cpu);
+    step(&cpu);
+    // INC keeps the carry of the ADD for the ADC
+    assert(cpu.registers.a == 0x02);
+    assert(mem_read(&cpu, cpu.registers.sp) == BIN(0b00000000));
+    assert(mem_read(&cpu, cpu.registers.sp + 1) == 0x02);
+    free_cpu(&cpu);
+}
+
+int main(int argc, char **argv) {
+#ifdef AOT
+    // make test-aot runs kogaboy-aot in between these two
+    if (argc == 3 && strcmp(argv[1], "aot-rom") == 0) {
+        write_aot_rom(argv[2]);
+        return 0;
+    }
+    if (argc == 4 && strcmp(argv[1], "aot-image") == 0) {
+        test_aot_image(argv[2], argv[3]);
+        return 0;
+    }
+#else
+    (void)argc;
+    (void)argv;
+#endif
+
     test_add();
     test_addhl();
     test_adc();
@@ -864,4 +2087,29 @@ int main() {
     test_call();
     test_ret();
     test_nop();
+
+    test_step();
+    test_cycles();
+    test_run();
+    test_self_modifying_code();
+    test_scheduler();
+    test_timer();
+    test_interrupts();
+    test_hot_loop();
+    test_dead_flags();
+    test_copy_loop();
+    test_bus();
+    test_memory_map();
+    test_cartridge();
+    test_mbc();
+    test_save();
+    test_rtc();
+#ifdef FASTMEM
+    test_fastmem();
+#endif
+#ifdef AOT
+    test_aot();
+#endif
+    test_inst_lengths();
+    test_flags();
 }
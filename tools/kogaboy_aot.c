@@ -0,0 +1,251 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/cpu.h"
+#include "../include/opcodes.h"
+// cpu.h has to come first
+#include "../include/aot.h"
+
+/* kogaboy-aot, ahead-of-time recompiler
+ *
+ * Usage: kogaboy-aot <rom> <output.c> [entry ...]
+ *
+ * Recovers the control flow graph of the first AOT_ROM_SIZE bytes of a ROM
+ * starting from the cartridge entry point, the RST vectors, the interrupt
+ * vectors and any extra entry points given on the command line. Every block
+ * is written as a C function that runs the handlers of handlers.h back to
+ * back, exactly like the block interpreter does. Compile the output with the
+ * same build options as the emulator, e.g.
+ *
+ *   gcc -O2 -shared -fPIC -Iinclude -DBLOCK_DISPATCH -DAOT game.c -o game.so
+ *
+ * and hand the shared object to load_aot(). Jumps through HL and returns
+ * have no static target, whatever they land on that was not found here is
+ * interpreted.
+ */
+
+#define AOT_MAX_INSTS 128
+#define CARTRIDGE_ENTRY 0x0100
+
+static const uint16_t vectors[] = {
+    0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38, /*RST*/
+    0x40, 0x48, 0x50, 0x58, 0x60,                   /*VBlank, STAT, Timer, Serial, Joypad*/
+};
+
+#define MAPPED_ENTRY(opcode, kind, bit_index, jump_cond, target, source) [opcode] = true,
+
+static const bool mapped[OPCODE_COUNT] = {BASE_OPCODES(MAPPED_ENTRY)};  // NOLINT
+
+typedef struct {
+    uint8_t rom[AOT_ROM_SIZE];
+    bool queued[AOT_ROM_SIZE];
+    uint16_t worklist[AOT_ROM_SIZE];
+    int worklist_len;
+    uint16_t block_ends[AOT_ROM_SIZE];
+    uint16_t block_cycles[AOT_ROM_SIZE];
+} Recompiler;
+
+static void queue(Recompiler *rc, uint32_t addr) {
+    if (addr >= AOT_ROM_SIZE || rc->queued[addr]) {
+        return;
+    }
+    rc->queued[addr] = true;
+    rc->worklist[rc->worklist_len++] = addr;
+}
+
+static bool writes_memory(const Instruction *inst) {
+    switch (inst->kind) {
+        case INC_IND:
+        case DEC_IND:
+        case PUSH:
+        case CALL:
+        case RST:
+            return true;
+        default:
+            return inst->target >= O_C_IND;
+    }
+}
+
+static bool ends_block(const Instruction *inst) {
+    switch (inst->kind) {
+        case JP:
+        case JP_HL:
+        case JR:
+        case CALL:
+        case RET:
+        case RETI:
+        case RST:
+        case EI:
+        case HALT:
+        case STOP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Queues the addresses execution can continue at after a block ending in inst */
+static void queue_successors(Recompiler *rc, const Instruction *inst, uint16_t addr,
+                             uint16_t next) {
+    uint16_t imm16 = rc->rom[(uint16_t)(addr + 1)] | rc->rom[(uint16_t)(addr + 2)] << BYTE_SIZE;
+    int8_t offset = (int8_t)rc->rom[(uint16_t)(addr + 1)];
+
+    switch (inst->kind) {
+        case JP:
+        case CALL:
+            queue(rc, imm16);
+            break;
+        case JR:
+            // JR jumps relative to its own address
+            queue(rc, (uint16_t)(addr + offset));
+            break;
+        case RST:
+            queue(rc, inst->bit_index);
+            break;
+        case JP_HL:
+        case RET:
+        case RETI:
+            break;
+        default:
+            queue(rc, next);
+            return;
+    }
+    // Not taken branches and returns from calls continue after the instruction
+    if (inst->kind == CALL || inst->kind == RST ||
+        (inst->kind != JP_HL && inst->jump_cond != ALWAYS)) {
+        queue(rc, next);
+    }
+}
+
+/* Writes the block starting at start, returns false if not even its first
+ * instruction lies within the ROM.
+ */
+static bool emit_block(Recompiler *rc, FILE *out, uint16_t start) {
+    uint32_t addr = start;
+    uint32_t cycles = 0;
+    bool end = false;
+
+    if (start + inst_lengths[rc->rom[start]] > AOT_ROM_SIZE) {
+        return false;
+    }
+
+    fprintf(out, "static void block_0x%04X(CPU *cpu) {\n", start);
+    for (int count = 0; !end && count < AOT_MAX_INSTS; count++) {
+        uint8_t inst_byte = rc->rom[addr];
+        const Instruction *inst = &inst_table[inst_byte];
+        uint8_t length = inst_lengths[inst_byte];
+        uint8_t inst_cycle_count = inst_cycles[inst_byte];
+        char handler[32];
+
+        if (inst_byte == PREFIX_BYTE) {
+            uint8_t pf_byte = rc->rom[(addr + 1) % AOT_ROM_SIZE];
+            inst = &pf_inst_table[pf_byte];
+            inst_cycle_count += pf_inst_cycles[pf_byte];
+            snprintf(handler, sizeof(handler), "pf_op_0x%02X", pf_byte);
+        } else if (mapped[inst_byte]) {
+            snprintf(handler, sizeof(handler), "op_0x%02X", inst_byte);
+        } else {
+            snprintf(handler, sizeof(handler), "op_handlers[0x%02X]", inst_byte);
+        }
+
+        // Operands past the ROM could be overwritten without being noticed
+        if (addr + length > AOT_ROM_SIZE) {
+            break;
+        }
+
+        end = ends_block(inst) || (inst_byte != PREFIX_BYTE && !mapped[inst_byte]);
+        fprintf(out, "    cpu->cycles += %u;\n", inst_cycle_count);
+        fprintf(out, "    cpu->registers.pc = %s(cpu);\n", handler);
+        if (!end && writes_memory(inst)) {
+            fprintf(out, "    if (cpu->code_written) {\n        return;\n    }\n");
+        }
+
+        if (end) {
+            queue_successors(rc, inst, addr, addr + length);
+        }
+        cycles += inst_cycle_count;
+        addr += length;
+    }
+    fprintf(out, "}\n\n");
+
+    if (!end) {
+        queue(rc, addr);
+    }
+    rc->block_ends[start] = addr;
+    rc->block_cycles[start] = cycles;
+    return true;
+}
+
+static bool read_rom(Recompiler *rc, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    // Smaller ROMs leave the rest zeroed, like the emulator's memory
+    size_t size = fread(rc->rom, 1, AOT_ROM_SIZE, file);
+    fclose(file);
+    if (size == 0) {
+        fprintf(stderr, "%s: empty ROM\n", path);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <rom> <output.c> [entry ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Recompiler *rc = calloc(1, sizeof(Recompiler));
+    if (rc == NULL || !read_rom(rc, argv[1])) {
+        free(rc);
+        return EXIT_FAILURE;
+    }
+
+    queue(rc, CARTRIDGE_ENTRY);
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        queue(rc, vectors[i]);
+    }
+    for (int i = 3; i < argc; i++) {
+        queue(rc, strtoul(argv[i], NULL, 0));
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL) {
+        perror(argv[2]);
+        free(rc);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(out, "/* Generated by kogaboy-aot from %s, do not edit */\n\n", argv[1]);
+    fprintf(out, "#include \"handlers.h\"\n");
+    fprintf(out, "// handlers.h has to come first\n#include \"aot.h\"\n\n");
+
+    // The worklist grows while blocks are written
+    int block_count = 0;
+    for (int i = 0; i < rc->worklist_len; i++) {
+        block_count += emit_block(rc, out, rc->worklist[i]);
+    }
+
+    fprintf(out, "static const AotBlock blocks[AOT_ROM_SIZE] = {\n");
+    for (uint32_t addr = 0; addr < AOT_ROM_SIZE; addr++) {
+        if (rc->block_ends[addr] != 0) {
+            fprintf(out, "    [0x%04X] = {block_0x%04X, 0x%04X, %u},\n", addr, addr,
+                    rc->block_ends[addr], rc->block_cycles[addr]);
+        }
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out,
+            "const AotModule kogaboy_aot_module = {AOT_ABI_VERSION, sizeof(CPU), AOT_BUILD_FLAGS,\n"
+            "                                      0x%08Xu, blocks};\n",
+            aot_checksum(rc->rom));
+
+    fclose(out);
+    printf("%d blocks written to %s\n", block_count, argv[2]);
+    free(rc);
+    return EXIT_SUCCESS;
+}